@@ -14,6 +14,7 @@ public class InteriorEditor : ModuleRules
                 "Core",
 				"CoreUObject",
 				"Engine",
+				"InteriorRuntime",
 				"Slate",
 				"SlateCore",
                 "EditorStyle",
@@ -27,7 +28,7 @@ public class InteriorEditor : ModuleRules
             }
         );
 
-		PrivateDependencyModuleNames.AddRange(new string[] { "KantanUtil" });
+		PrivateDependencyModuleNames.AddRange(new string[] { "KantanUtil", "DerivedDataCache" });
 
 		// Uncomment if you are using Slate UI
 		// PrivateDependencyModuleNames.AddRange(new string[] { "Slate", "SlateCore" });
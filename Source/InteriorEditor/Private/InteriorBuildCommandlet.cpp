@@ -0,0 +1,363 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "InteriorEditorPrivatePCH.h"
+#include "InteriorBuildCommandlet.h"
+#include "InteriorGraphActor.h"
+#include "InteriorGraphBuildTask.h"
+#include "InteriorGraphInstance.h"
+#include "InteriorEditorConversion.h"
+#include "EngineUtils.h"
+
+
+DEFINE_LOG_CATEGORY_STATIC(LogInteriorBuild, Log, All);
+
+
+/*
+Everything processed for a single map, along with how long each stage took.
+*/
+struct FInteriorMapBuild
+{
+	FString MapName;
+	UWorld* World;
+	TArray< AInteriorGraphActor* > Graphs;
+	// Graphs whose build result is stored, and their builds with the settings used
+	TArray< AInteriorGraphActor* > BuiltGraphs;
+	TArray< TSharedRef< FInteriorGraphBuildHandle > > Builds;
+	TArray< FInteriorGraphBuildSettings > BuildSettings;
+	int32 NumFailed;
+
+	double LoadTime;
+	double BuildTime;
+	double MeshTime;
+	double SaveTime;
+
+	FInteriorMapBuild():
+		World(nullptr),
+		NumFailed(0),
+		LoadTime(0.0),
+		BuildTime(0.0),
+		MeshTime(0.0),
+		SaveTime(0.0)
+	{}
+};
+
+
+UInteriorBuildCommandlet::UInteriorBuildCommandlet(FObjectInitializer const& OI): Super(OI)
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+}
+
+
+/*
+Resolves a short map name to its long package name, if needed.
+*/
+static bool ResolveMapName(FString const& Name, FString& OutLongName)
+{
+	if(FPackageName::IsValidLongPackageName(Name))
+	{
+		OutLongName = Name;
+		return FPackageName::DoesPackageExist(OutLongName);
+	}
+
+	return FPackageName::SearchForPackageOnDisk(Name + FPackageName::GetMapPackageExtension(), &OutLongName);
+}
+
+static UWorld* LoadMapForBuild(FString const& LongName)
+{
+	auto Pkg = LoadPackage(nullptr, *LongName, LOAD_None);
+	auto World = Pkg ? UWorld::FindWorldInPackage(Pkg) : nullptr;
+	if(!World)
+	{
+		return nullptr;
+	}
+
+	World->WorldType = EWorldType::Editor;
+	World->AddToRoot();
+	if(!World->bIsWorldInitialized)
+	{
+		// Builds trace the static geometry to remove hidden cells, and adaptive builds to refine near it
+		UWorld::InitializationValues IVS;
+		IVS.RequiresHitProxies(false);
+		IVS.ShouldSimulatePhysics(false);
+		IVS.EnableTraceCollision(true);
+		IVS.CreateNavigation(false);
+		IVS.CreateAISystem(false);
+		IVS.AllowAudioPlayback(false);
+		IVS.CreatePhysicsScene(true);
+
+		World->InitWorld(IVS);
+		World->PersistentLevel->UpdateModelComponents();
+		World->UpdateWorldComponents(true, false);
+	}
+	return World;
+}
+
+/*
+The settings a graph's build was last stored with, or the defaults if it never was, with any given on the command line
+taking precedence.
+*/
+static FInteriorGraphBuildSettings GetGraphBuildSettings(AInteriorGraphActor const* Graph, FString const& Params)
+{
+	auto const Stored = Graph->GetStoredBuildSettings();
+	auto Settings = Stored ? *Stored : FInteriorGraphBuildSettings();
+
+	if(FParse::Param(*Params, TEXT("Uniform")))
+	{
+		Settings.Mode = EInteriorSubdivisionMode::Uniform;
+	}
+	if(FParse::Param(*Params, TEXT("Adaptive")))
+	{
+		Settings.Mode = EInteriorSubdivisionMode::Adaptive;
+	}
+	FParse::Value(*Params, TEXT("Subdivision="), Settings.Subdivision);
+	FParse::Value(*Params, TEXT("SubdivisionZ="), Settings.SubdivisionZ);
+	FParse::Value(*Params, TEXT("CellSize="), Settings.TargetCellSize);
+	FParse::Value(*Params, TEXT("MinCellSize="), Settings.MinCellSize);
+	if(FParse::Param(*Params, TEXT("MergeCells")))
+	{
+		Settings.bMergeCells = true;
+	}
+	if(FParse::Param(*Params, TEXT("NoMergeCells")))
+	{
+		Settings.bMergeCells = false;
+	}
+	return Settings;
+}
+
+static void UnloadMap(UWorld* World)
+{
+	World->RemoveFromRoot();
+	World->CleanupWorld();
+}
+
+static FString GetGraphPackageName(FInteriorMapBuild const& Map, AInteriorGraphActor* Graph, FString const& OutPath)
+{
+	return OutPath / FPackageName::GetShortName(Map.MapName) + TEXT("_") + Graph->GetName();
+}
+
+static bool SaveMapPackages(FInteriorMapBuild const& Map, FString const& OutPath)
+{
+	auto bSuccess = true;
+
+	auto MapPkg = Map.World->GetOutermost();
+	auto const MapFile = FPackageName::LongPackageNameToFilename(MapPkg->GetName(), FPackageName::GetMapPackageExtension());
+	if(!GEditor->SavePackage(MapPkg, Map.World, RF_NoFlags, *MapFile, GWarn))
+	{
+		UE_LOG(LogInteriorBuild, Error, TEXT("Failed to save map %s"), *MapFile);
+		bSuccess = false;
+	}
+
+	// Every mesh generated from this map's graphs, whether a single asset or partitioned. Names are matched exactly,
+	// since a prefix would also match those of another map whose name extends this one's.
+	TArray< FString > GraphPackageNames;
+	for(auto Graph : Map.Graphs)
+	{
+		GraphPackageNames.Add(GetGraphPackageName(Map, Graph, OutPath));
+	}
+
+	for(TObjectIterator< UStaticMesh > It; It; ++It)
+	{
+		auto Pkg = It->GetOutermost();
+		if(It->GetOuter() != Pkg)
+		{
+			continue;
+		}
+
+		auto const Name = Pkg->GetName();
+		auto const bGenerated = GraphPackageNames.ContainsByPredicate([&Name](FString const& GraphPackageName)
+		{
+			return Name == GraphPackageName || IsPartitionPackageName(Name, GraphPackageName);
+		});
+		if(!bGenerated)
+		{
+			continue;
+		}
+
+		auto const File = FPackageName::LongPackageNameToFilename(Pkg->GetName(), FPackageName::GetAssetPackageExtension());
+		if(!GEditor->SavePackage(Pkg, nullptr, RF_Standalone, *File, GWarn))
+		{
+			UE_LOG(LogInteriorBuild, Error, TEXT("Failed to save mesh %s"), *File);
+			bSuccess = false;
+		}
+	}
+
+	return bSuccess;
+}
+
+
+int32 UInteriorBuildCommandlet::Main(FString const& Params)
+{
+	FString MapList;
+	if(!FParse::Value(*Params, TEXT("Maps="), MapList, false))
+	{
+		UE_LOG(LogInteriorBuild, Error, TEXT("No maps given, use -Maps=Map1+Map2+..."));
+		return 1;
+	}
+
+	FString OutPath = TEXT("/Game/Interiors");
+	FParse::Value(*Params, TEXT("OutPath="), OutPath);
+
+	int32 BatchSize = 4;
+	FParse::Value(*Params, TEXT("Batch="), BatchSize);
+	BatchSize = FMath::Max(BatchSize, 1);
+
+	auto const bOnlyStored = FParse::Param(*Params, TEXT("OnlyStored"));
+	auto const bMesh = !FParse::Param(*Params, TEXT("NoMesh"));
+	auto const bSave = !FParse::Param(*Params, TEXT("NoSave"));
+
+	TArray< FString > MapNames;
+	MapList.Replace(TEXT(","), TEXT("+")).ParseIntoArray(&MapNames, TEXT("+"), true);
+
+	auto NumFailed = 0;
+	TArray< FInteriorMapBuild > Results;
+	// Builds of a batch overlap, so their total is measured per batch rather than summed over maps
+	double TotalBuild = 0.0;
+	auto const StartTime = FPlatformTime::Seconds();
+
+	for(int32 BatchStart = 0; BatchStart < MapNames.Num(); BatchStart += BatchSize)
+	{
+		TArray< FInteriorMapBuild > Batch;
+
+		/*
+		Load every map in the batch, and find its graphs
+		*/
+		for(int32 Idx = BatchStart; Idx < FMath::Min(BatchStart + BatchSize, MapNames.Num()); ++Idx)
+		{
+			FInteriorMapBuild Map;
+			auto const LoadStart = FPlatformTime::Seconds();
+			if(!ResolveMapName(MapNames[Idx], Map.MapName) || (Map.World = LoadMapForBuild(Map.MapName)) == nullptr)
+			{
+				UE_LOG(LogInteriorBuild, Error, TEXT("Failed to load map %s"), *MapNames[Idx]);
+				++NumFailed;
+				continue;
+			}
+			Map.LoadTime = FPlatformTime::Seconds() - LoadStart;
+
+			for(TActorIterator< AInteriorGraphActor > It(Map.World); It; ++It)
+			{
+				Map.Graphs.Add(*It);
+			}
+
+			UE_LOG(LogInteriorBuild, Display, TEXT("Loaded %s, %i interior graphs"), *Map.MapName, Map.Graphs.Num());
+			Batch.Add(Map);
+		}
+
+		/*
+		Start the graph builds of the whole batch, so they run concurrently on the thread pool, then collect them in turn.
+		Nothing ticks while the commandlet runs, so each build's world queries are done up front, on this thread.
+		*/
+		auto const BuildStart = FPlatformTime::Seconds();
+		for(auto& Map : Batch)
+		{
+			for(auto Graph : Map.Graphs)
+			{
+				if(bOnlyStored && !Graph->GetStoredBuildSettings())
+				{
+					continue;
+				}
+
+				auto const Settings = GetGraphBuildSettings(Graph, Params);
+				auto Build = Graph->BuildGraphAsync(Settings);
+				Build->FinishWorldQueries();
+
+				Map.BuiltGraphs.Add(Graph);
+				Map.Builds.Add(Build);
+				Map.BuildSettings.Add(Settings);
+			}
+		}
+
+		for(auto& Map : Batch)
+		{
+			for(int32 GraphIdx = 0; GraphIdx < Map.BuiltGraphs.Num(); ++GraphIdx)
+			{
+				auto Graph = Map.BuiltGraphs[GraphIdx];
+				auto& Build = Map.Builds[GraphIdx];
+				Build->WaitForCompletion();
+
+				auto Inst = Build->GetResult();
+				if(!Inst.IsValid())
+				{
+					UE_LOG(LogInteriorBuild, Error, TEXT("%s: build of %s failed"), *Map.MapName, *Graph->GetName());
+					++Map.NumFailed;
+					continue;
+				}
+
+				UE_LOG(LogInteriorBuild, Display, TEXT("%s: built %s, %i cells, %i connections"),
+					*Map.MapName, *Graph->GetName(), Inst->NodeCount(), Inst->ConnectionCount());
+
+				Graph->StoreGraph(Inst, Map.BuildSettings[GraphIdx]);
+			}
+
+			// Builds overlap, so this is the time until this map's results were all available
+			Map.BuildTime = FPlatformTime::Seconds() - BuildStart;
+			Map.Builds.Empty();
+			Map.BuiltGraphs.Empty();
+			Map.BuildSettings.Empty();
+		}
+		TotalBuild += FPlatformTime::Seconds() - BuildStart;
+
+		/*
+		Mesh generation creates assets and actors, so stays on the game thread. Conversion of each graph's nodes is
+		itself spread across the thread pool.
+		*/
+		for(auto& Map : Batch)
+		{
+			if(bMesh)
+			{
+				auto const MeshStart = FPlatformTime::Seconds();
+				for(auto Graph : Map.Graphs)
+				{
+					auto const PackageName = GetGraphPackageName(Map, Graph, OutPath);
+					if(!ConvertInteriorGraphToSMAsset(Graph, PackageName))
+					{
+						UE_LOG(LogInteriorBuild, Error, TEXT("%s: mesh generation for %s failed"), *Map.MapName, *Graph->GetName());
+						++Map.NumFailed;
+					}
+				}
+				Map.MeshTime = FPlatformTime::Seconds() - MeshStart;
+			}
+
+			if(bSave && Map.Graphs.Num() > 0)
+			{
+				auto const SaveStart = FPlatformTime::Seconds();
+				if(!SaveMapPackages(Map, OutPath))
+				{
+					++Map.NumFailed;
+				}
+				Map.SaveTime = FPlatformTime::Seconds() - SaveStart;
+			}
+
+			UE_LOG(LogInteriorBuild, Display, TEXT("%s: load %.2fs, build %.2fs, mesh %.2fs, save %.2fs"),
+				*Map.MapName, Map.LoadTime, Map.BuildTime, Map.MeshTime, Map.SaveTime);
+
+			NumFailed += Map.NumFailed;
+			UnloadMap(Map.World);
+			Map.World = nullptr;
+			Map.Graphs.Empty();
+			Results.Add(Map);
+		}
+
+		CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+	}
+
+	/*
+	Summary
+	*/
+	double TotalLoad = 0.0, TotalMesh = 0.0, TotalSave = 0.0;
+	for(auto const& Map : Results)
+	{
+		TotalLoad += Map.LoadTime;
+		TotalMesh += Map.MeshTime;
+		TotalSave += Map.SaveTime;
+	}
+
+	UE_LOG(LogInteriorBuild, Display, TEXT("Processed %i of %i maps in %.2fs (load %.2fs, build %.2fs, mesh %.2fs, save %.2fs), %i failures"),
+		Results.Num(), MapNames.Num(), FPlatformTime::Seconds() - StartTime, TotalLoad, TotalBuild, TotalMesh, TotalSave, NumFailed);
+
+	return NumFailed > 0 ? 1 : 0;
+}
+
+
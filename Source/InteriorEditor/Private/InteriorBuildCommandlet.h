@@ -0,0 +1,37 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "Commandlets/Commandlet.h"
+
+#include "InteriorBuildCommandlet.generated.h"
+
+
+/**
+ * Rebuilds every interior graph in a list of maps without the editor UI, for use on build machines.
+ * The runtime graph of each graph is built and stored with the actor, or only of those which have been stored before
+ * if -OnlyStored is given. Static meshes are then generated as by the editor's Generate Static Mesh, named
+ * <OutPath>/<Map>_<Graph>. Changed maps and generated assets are then saved, and per-stage timings are reported.
+ *
+ * Usage: -run=InteriorBuild -Maps=/Game/Maps/A+/Game/Maps/B [-OutPath=/Game/Interiors] [-Batch=4]
+ *	[-Uniform | -Adaptive] [-Subdivision=1] [-SubdivisionZ=1] [-CellSize=400] [-MinCellSize=50]
+ *	[-MergeCells | -NoMergeCells] [-OnlyStored] [-NoMesh] [-NoSave]
+ *
+ * Each graph is built with the settings its build was last stored with, or the defaults if it never was. Any build
+ * settings given on the command line override those, for every graph.
+ *
+ * Maps are processed in batches of -Batch at a time; graph builds for all maps in a batch run concurrently.
+ */
+UCLASS()
+class UInteriorBuildCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UInteriorBuildCommandlet(FObjectInitializer const& OI);
+
+public:
+	virtual int32 Main(FString const& Params) override;
+};
+
+
@@ -5,6 +5,7 @@
 #include "InteriorEditorMode.h"
 #include "InteriorEditorCommands.h"
 #include "GraphDetailsCustomization.h"
+#include "InteriorEditorConversion.h"
 #include "IDetailsView.h"
 #include "PropertyEditorModule.h"
 
@@ -39,6 +40,8 @@ void FInteriorEditorModule::ShutdownModule()
 	FEditorModeRegistry::Get().UnregisterMode(
 		FInteriorEditorMode::ModeId
 		);
+
+	ReleaseConversionScratch();
 }
 
 
@@ -7,351 +7,1835 @@
 #include "RawMesh.h"
 #include "StaticMeshResources.h"
 #include "AssetRegistryModule.h"
+#include "AsyncWork.h"
+#include "EngineUtils.h"
+#include "Engine/StaticMeshActor.h"
+#include "PhysicsEngine/BodySetup.h"
 
 
 auto const Epsilon = 0.01f;
 
-struct FPortalEdgeInfo
+DECLARE_STATS_GROUP(TEXT("InteriorConversion"), STATGROUP_InteriorConversion, STATCAT_Advanced);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Faces Swept"), STAT_InteriorConversionFaces, STATGROUP_InteriorConversion);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Face Scratch Capacity Changes"), STAT_InteriorConversionCapacityChanges, STATGROUP_InteriorConversion);
+
+/*
+A rect of final geometry, lying in the plane Axis == Plane and facing along Dir.
+Rc is in terms of the other two axes, in the order given by FAxisUtils::OtherAxes.
+*/
+struct FConversionRect
+{
+	EAxisIndex Axis;
+	EAxisDirection Dir;
+	float Plane;
+	int32 MatIdx;
+	FBox2D Rc;
+	// Backs onto the face of a touching node
+	bool bShared;
+};
+
+
+/*
+Adds to the node's hidden areas the parts of its faces lying strictly inside the given volume, which overlaps it.
+*/
+void HideFacesInsideVolume(FConversionNode& Node, FBox const& Volume)
+{
+	auto const Box = Node.Data.Box();
+	for(EAxisIndex Axis : FAxisUtils::AllAxes)
+	{
+		for(EAxisDirection Dir : FAxisUtils::BothDirections)
+		{
+			auto const FaceValue = Node.Data.FaceAxisValue(Axis, Dir);
+			if(FaceValue <= Volume.Min[Axis] + Epsilon || FaceValue >= Volume.Max[Axis] - Epsilon)
+			{
+				continue;
+			}
+
+			auto Area = FBox(Box.Min.ComponentMax(Volume.Min), Box.Max.ComponentMin(Volume.Max));
+			Area.Min[Axis] = FaceValue;
+			Area.Max[Axis] = FaceValue;
+			Node.HiddenAreas.Add(Area);
+		}
+	}
+}
+
+
+void GatherConversionNodes(const AInteriorGraphActor* Graph, TArray< FConversionNode >& OutNodes)
+{
+	auto NodeIds = Graph->GetAllNodes();
+
+	TMap< NodeIdType, int32 > NodeIndices;
+	NodeIndices.Empty(NodeIds.Num());
+	OutNodes.Empty(NodeIds.Num());
+	OutNodes.SetNum(NodeIds.Num());
+	for(int32 Idx = 0; Idx < NodeIds.Num(); ++Idx)
+	{
+		auto const& Nd = Graph->GetNodeData(NodeIds[Idx]);
+		OutNodes[Idx].Id = NodeIds[Idx];
+		OutNodes[Idx].Data.Min = Nd.Min;
+		OutNodes[Idx].Data.Max = Nd.Max;
+		NodeIndices.Add(NodeIds[Idx], Idx);
+	}
+
+	for(auto CId : Graph->GetAllConnections())
+	{
+		auto const& Cn = Graph->GetConnectionData(CId);
+		auto SrcIdx = NodeIndices.Find(Cn.Src);
+		auto DestIdx = NodeIndices.Find(Cn.Dest);
+		if(SrcIdx)
+		{
+			OutNodes[*SrcIdx].Portals.Add(Cn.Portal);
+		}
+		if(DestIdx && Cn.Dest != Cn.Src)
+		{
+			OutNodes[*DestIdx].Portals.Add(Cn.Portal);
+		}
+	}
+
+	// Find nodes with overlapping volumes, whose faces within one another can't be seen
+	{
+		TArray< int32 > ByMinX;
+		ByMinX.Empty(OutNodes.Num());
+		for(int32 Idx = 0; Idx < OutNodes.Num(); ++Idx)
+		{
+			ByMinX.Add(Idx);
+		}
+		ByMinX.Sort([&OutNodes](int32 A, int32 B)
+		{
+			return OutNodes[A].Data.Min.X < OutNodes[B].Data.Min.X;
+		});
+
+		for(int32 Pos = 0; Pos < ByMinX.Num(); ++Pos)
+		{
+			auto const BoxA = OutNodes[ByMinX[Pos]].Data.Box();
+			for(int32 Other = Pos + 1; Other < ByMinX.Num(); ++Other)
+			{
+				auto const BoxB = OutNodes[ByMinX[Other]].Data.Box();
+				if(BoxB.Min.X >= BoxA.Max.X - Epsilon)
+				{
+					break;
+				}
+
+				if(BoxB.Min.Y >= BoxA.Max.Y - Epsilon || BoxA.Min.Y >= BoxB.Max.Y - Epsilon ||
+					BoxB.Min.Z >= BoxA.Max.Z - Epsilon || BoxA.Min.Z >= BoxB.Max.Z - Epsilon)
+				{
+					continue;
+				}
+
+				HideFacesInsideVolume(OutNodes[ByMinX[Pos]], BoxB);
+				HideFacesInsideVolume(OutNodes[ByMinX[Other]], BoxA);
+			}
+		}
+	}
+
+	// Find faces shared between touching nodes
+	for(EAxisIndex Axis : FAxisUtils::AllAxes)
+	{
+		// Sort by minimum along the axis, so for each node we can find those starting where it ends
+		TArray< int32 > ByMin;
+		ByMin.Empty(OutNodes.Num());
+		for(int32 Idx = 0; Idx < OutNodes.Num(); ++Idx)
+		{
+			ByMin.Add(Idx);
+		}
+		ByMin.Sort([&OutNodes, Axis](int32 A, int32 B)
+		{
+			return OutNodes[A].Data.Min[Axis] < OutNodes[B].Data.Min[Axis];
+		});
+
+		for(int32 Idx = 0; Idx < OutNodes.Num(); ++Idx)
+		{
+			auto const FaceValue = OutNodes[Idx].Data.Max[Axis];
+
+			// Lower bound on Min >= FaceValue - Epsilon
+			int32 Lo = 0;
+			int32 Hi = ByMin.Num();
+			while(Lo < Hi)
+			{
+				auto Mid = (Lo + Hi) / 2;
+				if(OutNodes[ByMin[Mid]].Data.Min[Axis] < FaceValue - Epsilon)
+				{
+					Lo = Mid + 1;
+				}
+				else
+				{
+					Hi = Mid;
+				}
+			}
+
+			for(int32 Pos = Lo; Pos < ByMin.Num(); ++Pos)
+			{
+				auto Adj = ByMin[Pos];
+				if(OutNodes[Adj].Data.Min[Axis] > FaceValue + Epsilon)
+				{
+					break;
+				}
+
+				FAxisAlignedPlanarArea Shared;
+				if(Adj == Idx ||
+					!TestForSharedSurface(OutNodes[Idx].Data.Box(), OutNodes[Adj].Data.Box(), Epsilon, &Shared) ||
+					Shared.FixedAxis != Axis)
+				{
+					continue;
+				}
+
+				auto const Area = FBox{ Shared.Min, Shared.Max };
+				if(Graph->bCullSharedFaces)
+				{
+					OutNodes[Idx].HiddenAreas.Add(Area);
+					OutNodes[Adj].HiddenAreas.Add(Area);
+				}
+				else
+				{
+					OutNodes[Idx].SharedAreas.Add(Area);
+					OutNodes[Adj].SharedAreas.Add(Area);
+				}
+			}
+		}
+	}
+}
+
+/*
+Appends those of the boxes lying on the given node face.
+*/
+void GatherOnFace(TArray< FBox > const& Boxes, FConversionNode const& Node, FFaceId Face, TArray< FBox >& Out)
+{
+	auto const FaceValue = Node.Data.FaceAxisValue(Face.Axis, Face.Dir);
+	for(auto const& Box : Boxes)
+	{
+		// TODO: This is a bit of a hacky test, should really just store more face/axis info with the portal
+		if(FMath::IsNearlyEqual(Box.GetCenter()[Face.Axis], FaceValue, 0.01f))
+		{
+			Out.Add(Box);
+		}
+	}
+}
+
+/*
+Determines the regions of a node face which should have no geometry: its portals and hidden areas.
+*/
+void GatherFaceHoles(FConversionNode const& Node, FFaceId Face, TArray< FBox >& OutHoles)
+{
+	OutHoles.Reset();
+	GatherOnFace(Node.Portals, Node, Face, OutHoles);
+	// These will generally contain portals, the sweep is fine with that
+	GatherOnFace(Node.HiddenAreas, Node, Face, OutHoles);
+}
+
+
+/*
+Returns 1 if the array's capacity has changed since it was last recorded in LastMax, 0 otherwise.
+This is a proxy for heap allocations, not a count of them: several reallocations between two checks count once, and
+allocations made other than by the array aren't seen at all.
+*/
+template< typename TArr >
+inline int32 TrackCapacityChange(TArr const& Arr, int32& LastMax)
+{
+	if(Arr.Max() == LastMax)
+	{
+		return 0;
+	}
+
+	LastMax = Arr.Max();
+	return 1;
+}
+
+
+/*
+Sweeps a face rect along its longitudinal axis, subtracting holes, and outputs rects covering what remains.
+
+Lateral coordinates of the face and hole extents are reduced to a sorted list of breaks, and a segment tree over the
+intervals between consecutive breaks tracks how many holes cover each, supporting range updates and searches for the
+next covered or uncovered interval in logarithmic time. The active spans are the maximal runs of uncovered intervals.
+All events at the same longitudinal position are handled together: the runs touching each event's lateral range are
+found before and after applying them, runs which no longer exist in the same form are closed off into rects, and new
+ones started. Only runs touching an event's range are visited, so a face with h holes producing r rects takes
+O((h + r) log h). Holes may overlap or touch one another.
+
+Scratch arrays are retained between faces, so a single instance should be reused for many faces on one thread.
+*/
+class FFaceSweep
+{
+public:
+	FFaceSweep():
+		NumIntervals(0),
+		BreaksMax(0),
+		EventsMax(0),
+		TreeMax(0),
+		SpanStartMax(0),
+		OldRunsMax(0),
+		NewRunsMax(0)
+	{}
+
+	/*
+	Number of scratch arrays whose capacity has changed since the last call.
+	*/
+	int32 CountCapacityChanges()
+	{
+		return TrackCapacityChange(Breaks, BreaksMax) +
+			TrackCapacityChange(Events, EventsMax) +
+			TrackCapacityChange(MinCover, TreeMax) * 3 +
+			TrackCapacityChange(SpanStart, SpanStartMax) +
+			TrackCapacityChange(OldRuns, OldRunsMax) +
+			TrackCapacityChange(NewRuns, NewRunsMax);
+	}
+
+	/*
+	Rects are output with X longitudinal and Y lateral, holes are given with their longitudinal and lateral extents
+	along axes LongAx and LatAx.
+	*/
+	void Sweep(
+		FBox2D const& Face,
+		TArray< FBox > const& Holes,
+		EAxisIndex LongAx,
+		EAxisIndex LatAx,
+		TArray< FBox2D >& OutRects
+		)
+	{
+		Breaks.Reset();
+		Events.Reset();
+
+		Breaks.Add(Face.Min.Y);
+		Breaks.Add(Face.Max.Y);
+		for(auto const& Hole : Holes)
+		{
+			if(ClipHole(Face, Hole, LongAx, LatAx))
+			{
+				Breaks.Add(FMath::Max(Hole.Min[LatAx], Face.Min.Y));
+				Breaks.Add(FMath::Min(Hole.Max[LatAx], Face.Max.Y));
+			}
+		}
+
+		// Sort and coalesce lateral values within Epsilon of one another
+		Breaks.Sort();
+		int32 NumBreaks = 1;
+		for(int32 Idx = 1; Idx < Breaks.Num(); ++Idx)
+		{
+			if(Breaks[Idx] - Breaks[NumBreaks - 1] > Epsilon)
+			{
+				Breaks[NumBreaks++] = Breaks[Idx];
+			}
+		}
+		Breaks.SetNum(NumBreaks);
+		if(NumBreaks < 2)
+		{
+			// Face has no lateral extent
+			return;
+		}
+
+		for(auto const& Hole : Holes)
+		{
+			if(ClipHole(Face, Hole, LongAx, LatAx))
+			{
+				auto const LatMin = FindBreak(FMath::Max(Hole.Min[LatAx], Face.Min.Y));
+				auto const LatMax = FindBreak(FMath::Min(Hole.Max[LatAx], Face.Max.Y));
+				if(LatMin < LatMax)
+				{
+					Events.Add(FEvent{ FMath::Max(Hole.Min[LongAx], Face.Min.X), LatMin, LatMax, 1 });
+					Events.Add(FEvent{ FMath::Min(Hole.Max[LongAx], Face.Max.X), LatMin, LatMax, -1 });
+				}
+			}
+		}
+
+		Events.Sort([](FEvent const& A, FEvent const& B)
+		{
+			return A.Long < B.Long;
+		});
+
+		NumIntervals = NumBreaks - 1;
+		MinCover.Reset();
+		MaxCover.Reset();
+		Pending.Reset();
+		MinCover.AddZeroed(NumIntervals * 4);
+		MaxCover.AddZeroed(NumIntervals * 4);
+		Pending.AddZeroed(NumIntervals * 4);
+		SpanStart.Reset();
+		SpanStart.AddUninitialized(NumIntervals);
+
+		// Initially the whole face is a single span
+		SpanStart[0] = Face.Min.X;
+
+		for(int32 First = 0; First < Events.Num();)
+		{
+			// Handle all events at (nearly) the same longitudinal position together
+			auto const Long = Events[First].Long;
+			auto Last = First;
+			while(Last < Events.Num() && Events[Last].Long - Long <= Epsilon)
+			{
+				++Last;
+			}
+
+			OldRuns.Reset();
+			for(int32 Idx = First; Idx < Last; ++Idx)
+			{
+				CollectRuns(Events[Idx].LatMin, Events[Idx].LatMax, OldRuns);
+			}
+
+			for(int32 Idx = First; Idx < Last; ++Idx)
+			{
+				auto const& Ev = Events[Idx];
+				AddCover(0, 0, NumIntervals, Ev.LatMin, Ev.LatMax, Ev.Delta);
+			}
+
+			NewRuns.Reset();
+			for(int32 Idx = First; Idx < Last; ++Idx)
+			{
+				CollectRuns(Events[Idx].LatMin, Events[Idx].LatMax, NewRuns);
+			}
+
+			UpdateSpans(Long, OutRects);
+			First = Last;
+		}
+
+		for(auto Idx = FindFirst(0, 0, NumIntervals, 0, 0, false); Idx < NumIntervals;)
+		{
+			auto const RunMax = FindFirst(0, 0, NumIntervals, Idx, 0, true);
+			AddRect(FRun{ Idx, RunMax }, Face.Max.X, OutRects);
+			Idx = FindFirst(0, 0, NumIntervals, RunMax, 0, false);
+		}
+	}
+
+protected:
+	struct FEvent
+	{
+		float Long;
+		// Lateral extents, as indices into Breaks
+		int32 LatMin, LatMax;
+		// +1 where a hole begins, -1 where it ends
+		int32 Delta;
+	};
+
+	/*
+	A maximal run of uncovered intervals [Min, Max).
+	*/
+	struct FRun
+	{
+		int32 Min, Max;
+	};
+
+	static bool ClipHole(FBox2D const& Face, FBox const& Hole, EAxisIndex LongAx, EAxisIndex LatAx)
+	{
+		return FMath::Min(Hole.Max[LongAx], Face.Max.X) - FMath::Max(Hole.Min[LongAx], Face.Min.X) > Epsilon &&
+			FMath::Min(Hole.Max[LatAx], Face.Max.Y) - FMath::Max(Hole.Min[LatAx], Face.Min.Y) > Epsilon;
+	}
+
+	/*
+	Index of the break nearest to the given value.
+	*/
+	int32 FindBreak(float Value) const
+	{
+		// First break > Value
+		int32 Lo = 0;
+		int32 Hi = Breaks.Num();
+		while(Lo < Hi)
+		{
+			auto Mid = (Lo + Hi) / 2;
+			if(Breaks[Mid] <= Value)
+			{
+				Lo = Mid + 1;
+			}
+			else
+			{
+				Hi = Mid;
+			}
+		}
+
+		auto Idx = FMath::Max(Lo - 1, 0);
+		if(Lo < Breaks.Num() && Breaks[Lo] - Value < Value - Breaks[Idx])
+		{
+			Idx = Lo;
+		}
+		return Idx;
+	}
+
+	void AddRect(FRun const& Run, float EndValue, TArray< FBox2D >& OutRects) const
+	{
+		auto const Start = SpanStart[Run.Min];
+		if(EndValue - Start > Epsilon)
+		{
+			// X is longitudinal, Y lateral
+			OutRects.Add(FBox2D{ FVector2D{ Start, Breaks[Run.Min] }, FVector2D{ EndValue, Breaks[Run.Max] } });
+		}
+	}
+
+	/*
+	Segment tree over the intervals. Each tree node holds the min and max cover of its subtree, including its own
+	pending addition, but not those of its ancestors, which are accumulated on the way down instead.
+	*/
+	void AddCover(int32 Node, int32 NodeLo, int32 NodeHi, int32 Lo, int32 Hi, int32 Delta)
+	{
+		if(Hi <= NodeLo || NodeHi <= Lo)
+		{
+			return;
+		}
+
+		if(Lo <= NodeLo && NodeHi <= Hi)
+		{
+			Pending[Node] += Delta;
+			MinCover[Node] += Delta;
+			MaxCover[Node] += Delta;
+			return;
+		}
+
+		auto const Mid = (NodeLo + NodeHi) / 2;
+		AddCover(Node * 2 + 1, NodeLo, Mid, Lo, Hi, Delta);
+		AddCover(Node * 2 + 2, Mid, NodeHi, Lo, Hi, Delta);
+		MinCover[Node] = FMath::Min(MinCover[Node * 2 + 1], MinCover[Node * 2 + 2]) + Pending[Node];
+		MaxCover[Node] = FMath::Max(MaxCover[Node * 2 + 1], MaxCover[Node * 2 + 2]) + Pending[Node];
+	}
+
+	/*
+	First interval at or after From which is covered (or uncovered), or NumIntervals if there is none.
+	*/
+	int32 FindFirst(int32 Node, int32 NodeLo, int32 NodeHi, int32 From, int32 Above, bool bCovered) const
+	{
+		if(NodeHi <= From || (bCovered ? MaxCover[Node] + Above == 0 : MinCover[Node] + Above > 0))
+		{
+			return NumIntervals;
+		}
+
+		if(NodeHi - NodeLo == 1)
+		{
+			return NodeLo;
+		}
+
+		auto const Mid = (NodeLo + NodeHi) / 2;
+		auto const Found = FindFirst(Node * 2 + 1, NodeLo, Mid, From, Above + Pending[Node], bCovered);
+		return Found < NumIntervals ? Found : FindFirst(Node * 2 + 2, Mid, NodeHi, From, Above + Pending[Node], bCovered);
+	}
+
+	/*
+	Last covered interval before Before, or -1 if there is none.
+	*/
+	int32 FindLastCovered(int32 Node, int32 NodeLo, int32 NodeHi, int32 Before, int32 Above) const
+	{
+		if(NodeLo >= Before || MaxCover[Node] + Above == 0)
+		{
+			return -1;
+		}
+
+		if(NodeHi - NodeLo == 1)
+		{
+			return NodeLo;
+		}
+
+		auto const Mid = (NodeLo + NodeHi) / 2;
+		auto const Found = FindLastCovered(Node * 2 + 2, Mid, NodeHi, Before, Above + Pending[Node]);
+		return Found >= 0 ? Found : FindLastCovered(Node * 2 + 1, NodeLo, Mid, Before, Above + Pending[Node]);
+	}
+
+	/*
+	Appends the runs overlapping or touching intervals [Lo, Hi), since those either side may join up with the range.
+	*/
+	void CollectRuns(int32 Lo, int32 Hi, TArray< FRun >& Out) const
+	{
+		auto Idx = FindFirst(0, 0, NumIntervals, FMath::Max(Lo - 1, 0), 0, false);
+		while(Idx <= Hi && Idx < NumIntervals)
+		{
+			// Only the first run found can begin before the range
+			auto const RunMin = FindLastCovered(0, 0, NumIntervals, Idx, 0) + 1;
+			auto const RunMax = FindFirst(0, 0, NumIntervals, Idx, 0, true);
+			Out.Add(FRun{ RunMin, RunMax });
+			Idx = FindFirst(0, 0, NumIntervals, RunMax, 0, false);
+		}
+	}
+
+	/*
+	Compares the runs around the changed ranges from before and after the changes. Runs are disjoint, so are
+	identified by where they begin.
+	*/
+	void UpdateSpans(float Long, TArray< FBox2D >& OutRects)
+	{
+		SortUniqueRuns(OldRuns);
+		SortUniqueRuns(NewRuns);
+
+		int32 OldIdx = 0;
+		int32 NewIdx = 0;
+		while(OldIdx < OldRuns.Num() || NewIdx < NewRuns.Num())
+		{
+			auto const bOld = OldIdx < OldRuns.Num() && (NewIdx == NewRuns.Num() || OldRuns[OldIdx].Min <= NewRuns[NewIdx].Min);
+			auto const bNew = NewIdx < NewRuns.Num() && (OldIdx == OldRuns.Num() || NewRuns[NewIdx].Min <= OldRuns[OldIdx].Min);
+			if(bOld && bNew && OldRuns[OldIdx].Max == NewRuns[NewIdx].Max)
+			{
+				// Unchanged, so carries on
+			}
+			else
+			{
+				// Close before starting, since both may begin at the same interval
+				if(bOld)
+				{
+					AddRect(OldRuns[OldIdx], Long, OutRects);
+				}
+				if(bNew)
+				{
+					SpanStart[NewRuns[NewIdx].Min] = Long;
+				}
+			}
+
+			OldIdx += bOld ? 1 : 0;
+			NewIdx += bNew ? 1 : 0;
+		}
+	}
+
+	static void SortUniqueRuns(TArray< FRun >& Runs)
+	{
+		Runs.Sort([](FRun const& A, FRun const& B)
+		{
+			return A.Min < B.Min;
+		});
+
+		int32 NumUnique = 0;
+		for(int32 Idx = 0; Idx < Runs.Num(); ++Idx)
+		{
+			if(NumUnique == 0 || Runs[Idx].Min != Runs[NumUnique - 1].Min)
+			{
+				Runs[NumUnique++] = Runs[Idx];
+			}
+		}
+		Runs.SetNum(NumUnique);
+	}
+
+protected:
+	TArray< float > Breaks;
+	TArray< FEvent > Events;
+
+	int32 NumIntervals;
+	// Segment tree of the number of holes covering each interval between consecutive breaks
+	TArray< int32 > MinCover;
+	TArray< int32 > MaxCover;
+	TArray< int32 > Pending;
+	// Longitudinal starting value of the span beginning at each interval, where there is one
+	TArray< float > SpanStart;
+	// Runs around the changed ranges, before and after a group of events
+	TArray< FRun > OldRuns;
+	TArray< FRun > NewRuns;
+
+	// Capacities as of the last CountCapacityChanges
+	int32 BreaksMax, EventsMax, TreeMax, SpanStartMax, OldRunsMax, NewRunsMax;
+};
+
+
+/*
+Per-thread working state for converting nodes, see GetThreadScratch. Everything is retained from face to face and
+from one conversion to the next, so once the arrays have grown to fit the largest face seen on the thread,
+conversion only allocates to grow its output.
+*/
+struct FConversionScratch
+{
+	FFaceSweep Sweep;
+	TArray< FBox > Holes;
+	TArray< FBox > Shared;
+	TArray< FBox2D > Rects;
+
+	// Profiling, over the thread's lifetime: faces converted, and capacity changes of arrays (scratch or output)
+	// in doing so
+	int32 NumFaces;
+	int32 NumCapacityChanges;
+
+	FConversionScratch():
+		NumFaces(0),
+		NumCapacityChanges(0),
+		HolesMax(0),
+		SharedMax(0),
+		RectsMax(0),
+		OutMax(0)
+	{}
+
+	/*
+	Output goes to a different array for each batch, so its capacity is tracked from the start of the batch.
+	*/
+	void BeginBatch(TArray< FConversionRect > const& Out)
+	{
+		OutMax = Out.Max();
+	}
+
+	void EndFace(TArray< FConversionRect > const& Out)
+	{
+		++NumFaces;
+		NumCapacityChanges += Sweep.CountCapacityChanges() +
+			TrackCapacityChange(Holes, HolesMax) +
+			TrackCapacityChange(Shared, SharedMax) +
+			TrackCapacityChange(Rects, RectsMax) +
+			TrackCapacityChange(Out, OutMax);
+	}
+
+protected:
+	int32 HolesMax, SharedMax, RectsMax, OutMax;
+};
+
+// Slot holding each thread's conversion scratch, allocated when the module loads, and freed by ReleaseConversionScratch
+static uint32 const ConversionScratchTlsSlot = FPlatformTLS::AllocTlsSlot();
+
+/*
+Every scratch handed out. Pool threads outlive the module, so scratch can't be freed as its thread exits, and is
+instead freed all at once on shutdown.
+*/
+static TArray< FConversionScratch* > AllConversionScratch;
+static FCriticalSection AllConversionScratchLock;
+
+/*
+Returns the calling thread's scratch, created on first use. Pool threads are reused for every conversion, so this is
+what lets repeated chunked and per-node updates run without reallocating. Scratch is kept until the module shuts
+down, and only ever holds as much as the largest face converted on its thread.
+*/
+FConversionScratch& GetThreadScratch()
+{
+	auto Scratch = static_cast< FConversionScratch* >(FPlatformTLS::GetTlsValue(ConversionScratchTlsSlot));
+	if(!Scratch)
+	{
+		Scratch = new FConversionScratch;
+		FPlatformTLS::SetTlsValue(ConversionScratchTlsSlot, Scratch);
+
+		FScopeLock Lock(&AllConversionScratchLock);
+		AllConversionScratch.Add(Scratch);
+	}
+	return *Scratch;
+}
+
+void ReleaseConversionScratch()
+{
+	FScopeLock Lock(&AllConversionScratchLock);
+	for(auto Scratch : AllConversionScratch)
+	{
+		delete Scratch;
+	}
+	AllConversionScratch.Empty();
+
+	FPlatformTLS::FreeTlsSlot(ConversionScratchTlsSlot);
+}
+
+
+auto const TexRepeatUnits = 100.f;
+
+enum MatTypes { Floor, Wall, Ceiling };
+
+/*
+Generates the rects making up the faces of a single node, minus its portals and hidden areas.
+Regions shared with touching nodes are swept separately, so that their rects can be told apart.
+*/
+void ConvertNode(FConversionNode const& Node, FConversionScratch& Scratch, TArray< FConversionRect >& Out)
+{
+	auto const& Nd = Node.Data;
+	auto& Holes = Scratch.Holes;
+	auto& Shared = Scratch.Shared;
+	auto& Rects = Scratch.Rects;
+	for(EAxisIndex Axis : FAxisUtils::AllAxes)
+	{
+		for(EAxisDirection Dir : FAxisUtils::BothDirections)
+		{
+			/*
+			Sweep along the first planar axis, with spans along the second
+			*/
+			auto const LongAx = FAxisUtils::OtherAxes[Axis][0];
+			auto const LatAx = FAxisUtils::OtherAxes[Axis][1];
+
+			auto const Face = FFaceId{ Axis, Dir };
+			auto const Plane = Nd.FaceAxisValue(Axis, Dir);
+			auto MatIdx = Axis == EAxisIndex::Z ? (Dir == EAxisDirection::Positive ? MatTypes::Ceiling : MatTypes::Floor) : MatTypes::Wall;
+
+			GatherFaceHoles(Node, Face, Holes);
+			Shared.Reset();
+			GatherOnFace(Node.SharedAreas, Node, Face, Shared);
+
+			// Shared regions of the face
+			for(auto const& Area : Shared)
+			{
+				Rects.Reset();
+				Scratch.Sweep.Sweep(
+					FBox2D{ FVector2D{ Area.Min[LongAx], Area.Min[LatAx] }, FVector2D{ Area.Max[LongAx], Area.Max[LatAx] } },
+					Holes,
+					LongAx,
+					LatAx,
+					Rects
+					);
+
+				for(auto const& Rc : Rects)
+				{
+					Out.Add(FConversionRect{ Axis, Dir, Plane, MatIdx, Rc, true });
+				}
+			}
+
+			// The rest of it
+			Holes.Append(Shared);
+			Rects.Reset();
+			Scratch.Sweep.Sweep(
+				FBox2D{ FVector2D{ Nd.Min[LongAx], Nd.Min[LatAx] }, FVector2D{ Nd.Max[LongAx], Nd.Max[LatAx] } },
+				Holes,
+				LongAx,
+				LatAx,
+				Rects
+				);
+
+			for(auto const& Rc : Rects)
+			{
+				Out.Add(FConversionRect{ Axis, Dir, Plane, MatIdx, Rc, false });
+			}
+
+			Scratch.EndFace(Out);
+		}
+	}
+}
+
+
+/*
+Converts a contiguous range of nodes on a pool thread.
+*/
+class FConvertNodesWorker: public FNonAbandonableTask
+{
+public:
+	FConvertNodesWorker(TArray< FConversionNode > const& InNodes, int32 InFirst, int32 InLast, TArray< FConversionRect >& InOut):
+		Nodes(InNodes),
+		First(InFirst),
+		Last(InLast),
+		Out(InOut),
+		NumFaces(0),
+		NumCapacityChanges(0)
+	{}
+
+	void DoWork()
+	{
+		auto& Scratch = GetThreadScratch();
+		auto const FacesBefore = Scratch.NumFaces;
+		auto const ChangesBefore = Scratch.NumCapacityChanges;
+
+		// At least one rect per face, unless a face is entirely hidden
+		Out.Reserve(Out.Num() + (Last - First) * (int32)EAxisIndex::Count * 2);
+		Scratch.BeginBatch(Out);
+		for(int32 Idx = First; Idx < Last; ++Idx)
+		{
+			ConvertNode(Nodes[Idx], Scratch, Out);
+		}
+
+		NumFaces = Scratch.NumFaces - FacesBefore;
+		NumCapacityChanges = Scratch.NumCapacityChanges - ChangesBefore;
+	}
+
+	FORCEINLINE TStatId GetStatId() const
+	{
+		RETURN_QUICK_DECLARE_CYCLE_STAT(FConvertNodesWorker, STATGROUP_ThreadPoolAsyncTasks);
+	}
+
+protected:
+	TArray< FConversionNode > const& Nodes;
+	int32 First, Last;
+	TArray< FConversionRect >& Out;
+
+public:
+	// Profiling for this batch alone
+	int32 NumFaces;
+	int32 NumCapacityChanges;
+};
+
+
+/*
+Converts all nodes, split into contiguous batches converted in parallel. The batch outputs are then concatenated
+in node order, so the result does not depend on how the work was scheduled.
+*/
+void ConvertNodesParallel(TArray< FConversionNode > const& Nodes, TArray< FConversionRect >& OutRects)
+{
+	auto const MinNodesPerBatch = 64;
+	auto const NumBatches = FMath::Clamp(
+		Nodes.Num() / MinNodesPerBatch,
+		1,
+		FMath::Max(FPlatformMisc::NumberOfCoresIncludingHyperthreads(), 1)
+		);
+
+	TArray< TArray< FConversionRect > > Batches;
+	Batches.SetNum(NumBatches);
+
+	// The first batch is done on this thread
+	TArray< FAsyncTask< FConvertNodesWorker >* > Tasks;
+	for(int32 Batch = 1; Batch < NumBatches; ++Batch)
+	{
+		auto const First = Nodes.Num() * Batch / NumBatches;
+		auto const Last = Nodes.Num() * (Batch + 1) / NumBatches;
+		auto Task = new FAsyncTask< FConvertNodesWorker >(Nodes, First, Last, Batches[Batch]);
+		Task->StartBackgroundTask();
+		Tasks.Add(Task);
+	}
+
+	FConvertNodesWorker LocalWorker(Nodes, 0, Nodes.Num() / NumBatches, Batches[0]);
+	LocalWorker.DoWork();
+
+	auto NumFaces = LocalWorker.NumFaces;
+	auto NumCapacityChanges = LocalWorker.NumCapacityChanges;
+	for(auto Task : Tasks)
+	{
+		Task->EnsureCompletion();
+		NumFaces += Task->GetTask().NumFaces;
+		NumCapacityChanges += Task->GetTask().NumCapacityChanges;
+		delete Task;
+	}
+
+	INC_DWORD_STAT_BY(STAT_InteriorConversionFaces, NumFaces);
+	INC_DWORD_STAT_BY(STAT_InteriorConversionCapacityChanges, NumCapacityChanges);
+	UE_LOG(LogTemp, Verbose, TEXT("Interior conversion: %d faces, %d array capacity changes (%.3f per face)"),
+		NumFaces, NumCapacityChanges, NumFaces > 0 ? (float)NumCapacityChanges / NumFaces : 0.f);
+
+	int32 NumRects = 0;
+	for(auto const& Batch : Batches)
+	{
+		NumRects += Batch.Num();
+	}
+
+	OutRects.Empty(NumRects);
+	for(auto const& Batch : Batches)
+	{
+		OutRects.Append(Batch);
+	}
+}
+
+
+/*
+Single pass combining rects which share a full edge perpendicular to axis Along.
+Returns true if any were combined.
+*/
+bool MergeRectsAlong(TArray< FBox2D >& Rects, int32 Along)
+{
+	auto const Other = 1 - Along;
+
+	// Rects which could combine are now consecutive
+	Rects.Sort([Along, Other](FBox2D const& A, FBox2D const& B)
+	{
+		if(A.Min[Other] != B.Min[Other])
+		{
+			return A.Min[Other] < B.Min[Other];
+		}
+		if(A.Max[Other] != B.Max[Other])
+		{
+			return A.Max[Other] < B.Max[Other];
+		}
+		return A.Min[Along] < B.Min[Along];
+	});
+
+	int32 NumOut = 0;
+	for(int32 Idx = 0; Idx < Rects.Num(); ++Idx)
+	{
+		auto const& Rc = Rects[Idx];
+		if(NumOut > 0)
+		{
+			auto& Prev = Rects[NumOut - 1];
+			if(FMath::IsNearlyEqual(Prev.Min[Other], Rc.Min[Other], Epsilon) &&
+				FMath::IsNearlyEqual(Prev.Max[Other], Rc.Max[Other], Epsilon) &&
+				FMath::IsNearlyEqual(Prev.Max[Along], Rc.Min[Along], Epsilon))
+			{
+				Prev.Max[Along] = Rc.Max[Along];
+				continue;
+			}
+		}
+
+		Rects[NumOut++] = Rc;
+	}
+
+	auto const bMerged = NumOut < Rects.Num();
+	Rects.SetNum(NumOut);
+	return bMerged;
+}
+
+/*
+Greedily combines rects lying in the same plane, facing the same way, with the same material and either both or neither
+backing onto a touching node, into larger rects.
+Within a group, rects sharing a full edge are joined along one axis then the other, until no more can be joined.
+*/
+void MergeCoplanarRects(TArray< FConversionRect >& Rects)
+{
+	auto IsSameGroup = [](FConversionRect const& A, FConversionRect const& B)
+	{
+		return A.Axis == B.Axis && A.Dir == B.Dir && A.Plane == B.Plane && A.MatIdx == B.MatIdx && A.bShared == B.bShared;
+	};
+
+	// Stable, so that the output order is deterministic
+	Rects.StableSort([](FConversionRect const& A, FConversionRect const& B)
+	{
+		if(A.Axis != B.Axis)
+		{
+			return A.Axis < B.Axis;
+		}
+		if(A.Dir != B.Dir)
+		{
+			return A.Dir < B.Dir;
+		}
+		if(A.Plane != B.Plane)
+		{
+			return A.Plane < B.Plane;
+		}
+		if(A.MatIdx != B.MatIdx)
+		{
+			return A.MatIdx < B.MatIdx;
+		}
+		return A.bShared < B.bShared;
+	});
+
+	TArray< FConversionRect > Merged;
+	Merged.Empty(Rects.Num());
+	TArray< FBox2D > Group;
+	for(int32 First = 0; First < Rects.Num();)
+	{
+		auto Last = First + 1;
+		while(Last < Rects.Num() && IsSameGroup(Rects[First], Rects[Last]))
+		{
+			++Last;
+		}
+
+		// Reset rather than Empty, which would reallocate for every group of a different size
+		Group.Reset();
+		for(int32 Idx = First; Idx < Last; ++Idx)
+		{
+			Group.Add(Rects[Idx].Rc);
+		}
+
+		auto bMerged = true;
+		while(bMerged)
+		{
+			auto const bMerged1 = MergeRectsAlong(Group, 0);
+			auto const bMerged2 = MergeRectsAlong(Group, 1);
+			bMerged = bMerged1 || bMerged2;
+		}
+
+		for(auto const& Rc : Group)
+		{
+			auto Rect = Rects[First];
+			Rect.Rc = Rc;
+			Merged.Add(Rect);
+		}
+
+		First = Last;
+	}
+
+	Rects = MoveTemp(Merged);
+}
+
+
+/*
+Emits two triangles per rect.
+*/
+void TriangulateRects(TArray< FConversionRect > const& Rects, FRawMesh& Mesh)
+{
+	Mesh.VertexPositions.Empty(Rects.Num() * 4);
+	Mesh.WedgeIndices.Empty(Rects.Num() * 6);
+	Mesh.WedgeTexCoords[0].Empty(Rects.Num() * 6);
+	Mesh.FaceMaterialIndices.Empty(Rects.Num() * 2);
+	Mesh.FaceSmoothingMasks.Empty(Rects.Num() * 2);
+
+	for(auto const& Rect : Rects)
+	{
+		auto const Axis = Rect.Axis;
+		auto const Dir = Rect.Dir;
+		auto const& Rc = Rect.Rc;
+		auto const PA1 = FAxisUtils::OtherAxes[Axis][0];
+		auto const PA2 = FAxisUtils::OtherAxes[Axis][1];
+
+		FBox Box3D;
+		Box3D.Min[PA1] = Rc.Min[0];
+		Box3D.Min[PA2] = Rc.Min[1];
+		Box3D.Min[Axis] = Rect.Plane;
+		Box3D.Max[PA1] = Rc.Max[0];
+		Box3D.Max[PA2] = Rc.Max[1];
+		Box3D.Max[Axis] = Rect.Plane;
+
+		FVector Planar1 = FVector::ZeroVector;
+		Planar1[PA1] = Box3D.Max[PA1] - Box3D.Min[PA1];
+		FVector Planar2 = FVector::ZeroVector;
+		Planar2[PA2] = Box3D.Max[PA2] - Box3D.Min[PA2];
+		if(Dir == EAxisDirection::Negative)
+		{
+			Swap(Planar1, Planar2);
+		}
+
+
+		auto VertexBase = Mesh.VertexPositions.Num();
+		Mesh.VertexPositions.Add(Box3D.Min);
+		Mesh.VertexPositions.Add(Box3D.Min + Planar2);
+		Mesh.VertexPositions.Add(Box3D.Max);
+		Mesh.VertexPositions.Add(Box3D.Min + Planar1);
+
+		auto FaceMaskIdx = (int)Axis + (Dir == EAxisDirection::Positive ? 0 : (int)EAxisIndex::Count);
+
+		// Ensure that texture coordinates always use V for Z if Z exists
+		auto TA1 = FMath::Min(PA1, PA2);
+		auto TA2 = FMath::Max(PA1, PA2);
+
+		auto AddWedge = [&](int32 Corner)
+		{
+			auto const VIdx = VertexBase + Corner;
+			auto const& Pos = Mesh.VertexPositions[VIdx];
+			Mesh.WedgeIndices.Add(VIdx);
+			Mesh.WedgeTexCoords[0].Add(FVector2D{ Pos[TA1], Pos[TA2] } / TexRepeatUnits);
+		};
+
+		Mesh.FaceMaterialIndices.Add(Rect.MatIdx);
+		Mesh.FaceSmoothingMasks.Add(1 << FaceMaskIdx);
+		AddWedge(0);
+		AddWedge(2);
+		AddWedge(1);
+		Mesh.FaceMaterialIndices.Add(Rect.MatIdx);
+		Mesh.FaceSmoothingMasks.Add(1 << FaceMaskIdx);
+		AddWedge(0);
+		AddWedge(3);
+		AddWedge(2);
+	}
+}
+
+
+/*
+Cell of the uniform grid used to find coincident vertices.
+*/
+struct FWeldCell
+{
+	int32 X, Y, Z;
+
+	inline bool operator== (FWeldCell const& Rhs) const
+	{
+		return X == Rhs.X && Y == Rhs.Y && Z == Rhs.Z;
+	}
+
+	static inline FWeldCell FromPosition(FVector const& Pos, float CellSize)
+	{
+		return FWeldCell{
+			FMath::FloorToInt(Pos.X / CellSize),
+			FMath::FloorToInt(Pos.Y / CellSize),
+			FMath::FloorToInt(Pos.Z / CellSize)
+		};
+	}
+
+	friend inline uint32 GetTypeHash(FWeldCell const& Cell)
+	{
+		return HashCombine(HashCombine(GetTypeHash(Cell.X), GetTypeHash(Cell.Y)), GetTypeHash(Cell.Z));
+	}
+};
+
+/*
+Merges vertices lying within Tolerance of one another, remapping the wedges to refer to the merged vertices.
+Since the grid cells are Tolerance in size, any match lies in the vertex's own or an adjacent cell.
+Returns the number of vertices removed.
+*/
+int32 WeldVertices(FRawMesh& Mesh, float Tolerance)
+{
+	auto const NumVerts = Mesh.VertexPositions.Num();
+	auto const TolSq = Tolerance * Tolerance;
+
+	TArray< FVector > Welded;
+	Welded.Empty(NumVerts);
+	TArray< int32 > Remap;
+	Remap.Empty(NumVerts);
+	TMultiMap< FWeldCell, int32 > Grid;
+
+	for(auto const& Pos : Mesh.VertexPositions)
+	{
+		auto const Cell = FWeldCell::FromPosition(Pos, Tolerance);
+
+		int32 Match = INDEX_NONE;
+		for(int32 DZ = -1; DZ <= 1 && Match == INDEX_NONE; ++DZ)
+		{
+			for(int32 DY = -1; DY <= 1 && Match == INDEX_NONE; ++DY)
+			{
+				for(int32 DX = -1; DX <= 1 && Match == INDEX_NONE; ++DX)
+				{
+					auto const Key = FWeldCell{ Cell.X + DX, Cell.Y + DY, Cell.Z + DZ };
+					for(auto It = Grid.CreateConstKeyIterator(Key); It; ++It)
+					{
+						if(FVector::DistSquared(Welded[It.Value()], Pos) <= TolSq)
+						{
+							Match = It.Value();
+							break;
+						}
+					}
+				}
+			}
+		}
+
+		if(Match == INDEX_NONE)
+		{
+			Match = Welded.Add(Pos);
+			Grid.Add(Cell, Match);
+		}
+		Remap.Add(Match);
+	}
+
+	for(auto& VIdx : Mesh.WedgeIndices)
+	{
+		VIdx = Remap[VIdx];
+	}
+
+	Mesh.VertexPositions = MoveTemp(Welded);
+	return NumVerts - Mesh.VertexPositions.Num();
+}
+
+// A face shared with a touching node has no room behind it, so is given a slab straddling the plane which is only
+// as thick as needed to be solid
+auto const SharedCollisionThickness = 1.f;
+
+/*
+Generates a box behind each rect, extending away from the node the rect faces into.
+Rects have already been merged, so this results in one slab per maximal coplanar area.
+Shared regions are emitted back to back by both touching nodes; only the positive facing one generates a slab.
+*/
+void GenerateCollisionBoxes(TArray< FConversionRect > const& Rects, float CollisionThickness, TArray< FBox >& OutBoxes)
 {
-	// These are along the lateral axis
-	float MinExtent;
-	float MaxExtent;
-};
+	OutBoxes.Empty(Rects.Num());
+	for(auto const& Rect : Rects)
+	{
+		auto const PA1 = FAxisUtils::OtherAxes[Rect.Axis][0];
+		auto const PA2 = FAxisUtils::OtherAxes[Rect.Axis][1];
+
+		FBox Box;
+		Box.Min[PA1] = Rect.Rc.Min[0];
+		Box.Min[PA2] = Rect.Rc.Min[1];
+		Box.Max[PA1] = Rect.Rc.Max[0];
+		Box.Max[PA2] = Rect.Rc.Max[1];
+		if(Rect.bShared)
+		{
+			if(Rect.Dir != EAxisDirection::Positive)
+			{
+				continue;
+			}
+
+			Box.Min[Rect.Axis] = Rect.Plane - SharedCollisionThickness * 0.5f;
+			Box.Max[Rect.Axis] = Rect.Plane + SharedCollisionThickness * 0.5f;
+		}
+		else
+		{
+			// A node's positive face is at its max, so the slab goes beyond that
+			Box.Min[Rect.Axis] = Rect.Dir == EAxisDirection::Positive ? Rect.Plane : Rect.Plane - CollisionThickness;
+			Box.Max[Rect.Axis] = Rect.Dir == EAxisDirection::Positive ? Rect.Plane + CollisionThickness : Rect.Plane;
+		}
+		Box.IsValid = true;
+		OutBoxes.Add(Box);
+	}
+}
 
-struct FCombinedPortalEdgeInfo
+void ConvertNodesToRawMesh(
+	TArray< FConversionNode > const& Nodes,
+	FRawMesh& Mesh,
+	TArray< FBox >* OutCollisionBoxes,
+	float CollisionThickness
+	)
 {
-	enum EType { End, Begin };
+	Mesh.Empty();
 
-	float AxisValue;
-	EType Type;
-	TArray< FPortalEdgeInfo > Edges;
+	TArray< FConversionRect > Rects;
+	ConvertNodesParallel(Nodes, Rects);
 
-	inline bool operator< (FCombinedPortalEdgeInfo const& RHS) const
+	MergeCoplanarRects(Rects);
+	TriangulateRects(Rects, Mesh);
+	if(OutCollisionBoxes)
 	{
-		return AxisValue < RHS.AxisValue || (AxisValue == RHS.AxisValue && Type < RHS.Type);
+		GenerateCollisionBoxes(Rects, CollisionThickness, *OutCollisionBoxes);
 	}
-};
 
-typedef TArray< FCombinedPortalEdgeInfo > CombinedPortalEdgeList;
+	// Rects sharing corners each emitted their own vertices
+	WeldVertices(Mesh, Epsilon);
+
+//	Mesh.WedgeColors.Init(FColor::White, Mesh.WedgeIndices.Num());
+}
+
+bool ConvertInteriorGraphToRawMesh(AInteriorGraphActor* Graph, FRawMesh& Mesh, TArray< FBox >* OutCollisionBoxes)
+{
+	TArray< FConversionNode > Nodes;
+	GatherConversionNodes(Graph, Nodes);
+
+	ConvertNodesToRawMesh(Nodes, Mesh, OutCollisionBoxes, Graph->CollisionThickness);
+	return Mesh.IsValidOrFixable();
+}
+
+
+bool BoxesEqual(FBox const& A, FBox const& B)
+{
+	return A.Min == B.Min && A.Max == B.Max;
+}
+
+bool BoxListsEqual(TArray< FBox > const& A, TArray< FBox > const& B)
+{
+	if(A.Num() != B.Num())
+	{
+		return false;
+	}
+
+	for(int32 Idx = 0; Idx < A.Num(); ++Idx)
+	{
+		if(!BoxesEqual(A[Idx], B[Idx]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+Whether the two would generate the same geometry.
+*/
+bool ConversionNodesEqual(FConversionNode const& A, FConversionNode const& B)
+{
+	return A.Data.Min == B.Data.Min && A.Data.Max == B.Data.Max &&
+		BoxListsEqual(A.Portals, B.Portals) &&
+		BoxListsEqual(A.HiddenAreas, B.HiddenAreas) &&
+		BoxListsEqual(A.SharedAreas, B.SharedAreas);
+}
 
 
-CombinedPortalEdgeList GeneratePortalEdges(const AInteriorGraphActor* Graph, NodeIdType NId, FFaceId Face)
+FInteriorMeshConversionCache::FInteriorMeshConversionCache(
+	EInteriorMeshPartition::Type InPartition,
+	float InChunkSize,
+	FString const& InPackageName,
+	float InCollisionThickness
+	):
+Partition(InPartition),
+ChunkSize(InChunkSize),
+PackageName(InPackageName),
+CollisionThickness(InCollisionThickness)
 {
-	auto const PA1 = FAxisUtils::OtherAxes[Face.Axis][0];
-	auto const PA2 = FAxisUtils::OtherAxes[Face.Axis][1];
+	check(Partition != EInteriorMeshPartition::Grid || ChunkSize > 0.f);
+}
+
+FInteriorChunkCoord FInteriorMeshConversionCache::PartitionOf(FConversionNode const& Node) const
+{
+	if(Partition == EInteriorMeshPartition::PerNode)
+	{
+		return FInteriorChunkCoord{ (int32)Node.Id, 0, 0 };
+	}
+
+	return FInteriorChunkCoord::FromPosition(Node.Data.Box().GetCenter(), ChunkSize);
+}
 
-	auto PortalIds = Graph->GetConnectionsOnFace(NId, Face);
-	CombinedPortalEdgeList Edges;
-	for(auto PId : PortalIds)
+TArray< FInteriorChunkCoord > FInteriorMeshConversionCache::Update(AInteriorGraphActor const* Graph)
+{
+	// Hidden areas depend on the surrounding nodes, so gathering has to look at the whole graph
+	TArray< FConversionNode > AllNodes;
+	GatherConversionNodes(Graph, AllNodes);
+
+	TSet< FInteriorChunkCoord > DirtyChunks;
+	TSet< NodeIdType > LiveIds;
+	LiveIds.Reserve(AllNodes.Num());
+	for(auto const& Node : AllNodes)
 	{
-		auto const& Cn = Graph->GetConnectionData(PId);
+		LiveIds.Add(Node.Id);
 
-		FPortalEdgeInfo Edge;
-		Edge.MinExtent = Cn.Portal.Min[PA2];
-		Edge.MaxExtent = Cn.Portal.Max[PA2];
+		auto Cached = Nodes.Find(Node.Id);
+		if(Cached && ConversionNodesEqual(*Cached, Node))
+		{
+			continue;
+		}
+
+		// Node is new or modified, in which case it may also have moved out of its previous chunk
+		DirtyChunks.Add(PartitionOf(Node));
+		if(Cached)
+		{
+			DirtyChunks.Add(PartitionOf(*Cached));
+		}
+	}
 
+	for(auto const& Entry : Nodes)
+	{
+		if(!LiveIds.Contains(Entry.Key))
 		{
-			FCombinedPortalEdgeInfo Combined;
-			Combined.AxisValue = Cn.Portal.Min[PA1];
-			Combined.Type = FCombinedPortalEdgeInfo::Begin;
-			Combined.Edges.Add(Edge);
-			Edges.Add(Combined);
+			DirtyChunks.Add(PartitionOf(Entry.Value));
 		}
+	}
 
+	// Regather the nodes of each dirty chunk and reconvert
+	TMap< FInteriorChunkCoord, TArray< FConversionNode > > ChunkNodes;
+	Nodes.Empty(AllNodes.Num());
+	for(auto& Node : AllNodes)
+	{
+		auto const Coord = PartitionOf(Node);
+		if(DirtyChunks.Contains(Coord))
 		{
-			FCombinedPortalEdgeInfo Combined;
-			Combined.AxisValue = Cn.Portal.Max[PA1];
-			Combined.Type = FCombinedPortalEdgeInfo::End;
-			Combined.Edges.Add(Edge);
-			Edges.Add(Combined);
+			ChunkNodes.FindOrAdd(Coord).Add(Node);
 		}
+		Nodes.Add(Node.Id, MoveTemp(Node));
 	}
 
-	// TODO: Compact/merge edges
+	TArray< FInteriorChunkCoord > Changed;
+	for(auto const& Coord : DirtyChunks)
+	{
+		auto Chunk = ChunkNodes.Find(Coord);
+		if(Chunk)
+		{
+			auto& Section = Sections.FindOrAdd(Coord);
+			ConvertNodesToRawMesh(*Chunk, Section.Mesh, CollisionThickness > 0.f ? &Section.CollisionBoxes : nullptr, CollisionThickness);
+		}
+		else
+		{
+			Sections.Remove(Coord);
+		}
+		Changed.Add(Coord);
+	}
 
-	Edges.Sort();
-	return Edges;
+	return Changed;
 }
 
-struct FSpan
+
+UStaticMesh* CreateStaticMesh(struct FRawMesh& RawMesh, TArray<UMaterialInterface*>& Materials, UObject* InOuter, FName InName, TArray< FBox > const* CollisionBoxes);
+
+/*
+If CollisionBoxes is given, they form the mesh's simple collision and are also used for complex queries, otherwise
+collision is per triangle.
+*/
+UStaticMesh* CreateSMAsset(FRawMesh& Raw, FString const& PackageName, TArray< FBox > const* CollisionBoxes)
 {
-	float Min, Max;	// Lateral extents
-	float Start;	// Longitudinal starting value for the span
-};
+	FName ObjName = *FPackageName::GetLongPackageAssetName(PackageName);
+	UPackage* Pkg = CreatePackage(nullptr, *PackageName);
+	check(Pkg != nullptr);
+
+	TArray< UMaterialInterface* > Mats;
+	Mats.Add(UMaterial::GetDefaultMaterial(EMaterialDomain::MD_Surface));	//GEditor->EditorBrushMaterial);
+	Mats.Add(UMaterial::GetDefaultMaterial(EMaterialDomain::MD_Surface));
+	Mats.Add(UMaterial::GetDefaultMaterial(EMaterialDomain::MD_Surface));
 
-typedef TArray< FSpan > SpanList;
+	UStaticMesh* SM = CreateStaticMesh(Raw, Mats, Pkg, ObjName, CollisionBoxes);
+	if(SM)
+	{
+		FAssetRegistryModule::AssetCreated(SM);
+	}
+	return SM;
+}
 
-bool EdgeSeparatesSpans(FPortalEdgeInfo const& Edge, FSpan const& S1, FSpan const& S2)
+FString GetPartitionPackageName(FInteriorMeshConversionCache const& Cache, FInteriorChunkCoord const& Coord)
 {
-	return FMath::IsNearlyEqual(Edge.MinExtent, S1.Max, Epsilon) &&
-		FMath::IsNearlyEqual(Edge.MaxExtent, S2.Min, Epsilon);
+	if(Cache.GetPartition() == EInteriorMeshPartition::PerNode)
+	{
+		return FString::Printf(TEXT("%s_Node%d"), *Cache.GetPackageName(), Coord.X);
+	}
+
+	return FString::Printf(TEXT("%s_%d_%d_%d"), *Cache.GetPackageName(), Coord.X, Coord.Y, Coord.Z);
 }
 
-FBox2D CreateSpanRect(FSpan const& S, float EndValue)
+UStaticMesh* FindPartitionAsset(FString const& PartitionPackageName)
 {
-	FBox2D Rc;
-	// X is longitudinal, Y lateral
-	Rc.Min = FVector2D{ S.Start, S.Min };
-	Rc.Max = FVector2D{ EndValue, S.Max };
-	return Rc;
+	auto const ObjectPath = PartitionPackageName + TEXT(".") + FPackageName::GetLongPackageAssetName(PartitionPackageName);
+	return FindObject< UStaticMesh >(nullptr, *ObjectPath);
 }
 
-TArray< FBox2D > MergeSpans(SpanList& Spans, FPortalEdgeInfo const& Edge, float CurValue)
+bool IsPartitionPackageName(FString const& Name, FString const& PackageName)
 {
-	for(int i = 0; i < Spans.Num() - 1; ++i)
+	auto const Prefix = PackageName + TEXT("_");
+	if(!Name.StartsWith(Prefix))
 	{
-		auto j = i + 1;
-
-		if(EdgeSeparatesSpans(Edge, Spans[i], Spans[j]))
-		{
-			TArray< FBox2D > Rects;
-			Rects.Add(CreateSpanRect(Spans[i], CurValue));
-			Rects.Add(CreateSpanRect(Spans[j], CurValue));
-
-			Spans[i].Max = Spans[j].Max;
-			Spans[i].Start = CurValue;
-			Spans.RemoveAt(j);
+		return false;
+	}
 
-			return Rects;
-		}
+	// Per-node and streamed parts are numbered, grid partitions are named by their coordinate
+	auto const Suffix = Name.Mid(Prefix.Len());
+	if(Suffix.StartsWith(TEXT("Node")) || Suffix.StartsWith(TEXT("Part")))
+	{
+		return Suffix.Len() > 4 && Suffix.Mid(4).IsNumeric();
 	}
 
-	check(false);
-	return{};
+	TArray< FString > Coords;
+	Suffix.ParseIntoArray(&Coords, TEXT("_"), false);
+	return Coords.Num() == 3 && Coords[0].IsNumeric() && Coords[1].IsNumeric() && Coords[2].IsNumeric();
 }
 
-bool SpanEncompassesEdge(FPortalEdgeInfo const& Edge, FSpan const& S)
+/*
+Destroys the level actors displaying each generated asset of PackageName which isn't among Current, whether the
+asset is loaded or only on disk. Names are derived from node ids and chunk coords, and node ids are reassigned on
+load while the conversion cache doesn't persist, so what was generated previously can't be known from the cache.
+*/
+void RemoveStalePartitions(
+	AInteriorGraphActor* Graph,
+	TMap< UStaticMesh*, TArray< AStaticMeshActor* > > const& MeshActors,
+	FString const& PackageName,
+	TSet< FString > const& Current
+	)
 {
-	// todo: use Epsilon here??
-	return S.Min <= Edge.MinExtent && S.Max >= Edge.MaxExtent;
+	TSet< FString > Generated;
+
+	auto& AssetRegistry = FModuleManager::LoadModuleChecked< FAssetRegistryModule >(TEXT("AssetRegistry")).Get();
+	TArray< FAssetData > Assets;
+	AssetRegistry.GetAssetsByPath(FName(*FPackageName::GetLongPackagePath(PackageName)), Assets);
+	for(auto const& Asset : Assets)
+	{
+		Generated.Add(Asset.PackageName.ToString());
+	}
+
+	// Also anything placed which was never saved
+	for(auto const& Entry : MeshActors)
+	{
+		Generated.Add(Entry.Key->GetOutermost()->GetName());
+	}
+
+	for(auto const& Name : Generated)
+	{
+		if(Current.Contains(Name) || !IsPartitionPackageName(Name, PackageName))
+		{
+			continue;
+		}
+
+		auto SM = FindPartitionAsset(Name);
+		auto Existing = SM ? MeshActors.Find(SM) : nullptr;
+		if(Existing)
+		{
+			for(auto Actor : *Existing)
+			{
+				Actor->Modify();
+				Graph->GetWorld()->EditorDestroyActor(Actor, true);
+			}
+		}
+
+		UE_LOG(LogTemp, Warning, TEXT("Interior mesh partition %s is no longer used, and can be deleted."), *Name);
+	}
 }
 
-TArray< FBox2D > SplitOrContractSpans(SpanList& Spans, FPortalEdgeInfo const& Edge, float CurValue)
+/*
+Moves every level actor displaying the mesh to Location, or places a new one if there are none.
+The actors are made owned by the graph, so that they are left out of its build cache key.
+Expects to be called within a transaction, with the graph's level already modified.
+*/
+void PlacePartitionActors(
+	AInteriorGraphActor* Graph,
+	TMap< UStaticMesh*, TArray< AStaticMeshActor* > > const& MeshActors,
+	UStaticMesh* SM,
+	FVector const& Location
+	)
 {
-	TArray< FBox2D > Rects;
-	for(int i = 0; i < Spans.Num(); ++i)
+	auto Existing = MeshActors.Find(SM);
+	if(Existing)
 	{
-		if(SpanEncompassesEdge(Edge, Spans[i]))
+		for(auto Actor : *Existing)
 		{
-			// This span contains the new edge fully, so split span into one either side
-			Rects.Add(CreateSpanRect(Spans[i], CurValue));
+			Actor->Modify();
+			Actor->SetActorLocation(Location);
+			Actor->SetOwner(Graph);
+		}
+		return;
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.OverrideLevel = Graph->GetLevel();
+	SpawnParams.Owner = Graph;
+	auto Actor = Graph->GetWorld()->SpawnActor< AStaticMeshActor >(Location, FRotator::ZeroRotator, SpawnParams);
+	if(Actor)
+	{
+		Actor->GetStaticMeshComponent()->SetStaticMesh(SM);
+		Actor->SetActorLabel(SM->GetName());
+	}
+}
 
-			FSpan NewSpan;
-			NewSpan.Start = CurValue;
-			NewSpan.Min = Spans[i].Min;
-			NewSpan.Max = Edge.MinExtent;
+bool ConvertInteriorGraphToPartitionedSMAssets(AInteriorGraphActor* Graph, FString const& PackageName)
+{
+	auto World = Graph->GetWorld();
+	if(!World)
+	{
+		return false;
+	}
 
-			Spans[i].Start = CurValue;
-			Spans[i].Min = Edge.MaxExtent;
-			// Max unchanged
+	// Collision is baked into every asset, so changing it has to regenerate all of them
+	auto const CollisionThickness = Graph->bBoxCollision ? Graph->CollisionThickness : 0.f;
+	auto& Cache = Graph->GetMeshConversionCache();
+	if(!Cache.IsValid() ||
+		Cache->GetPartition() != Graph->MeshPartition ||
+		Cache->GetChunkSize() != Graph->MeshChunkSize ||
+		Cache->GetPackageName() != PackageName ||
+		Cache->GetCollisionThickness() != CollisionThickness)
+	{
+		Cache = MakeShareable(new FInteriorMeshConversionCache(Graph->MeshPartition, Graph->MeshChunkSize, PackageName, CollisionThickness));
+	}
 
-			Spans.Insert(NewSpan, i);
+	auto Changed = Cache->Update(Graph);
 
-			// No other spans can hit the edge
-			break;
+	// Unchanged sections whose asset has since gone away are recreated from the cache, without reconverting
+	TSet< FString > Current;
+	for(auto const& Entry : Cache->GetSections())
+	{
+		auto const PartitionPackageName = GetPartitionPackageName(*Cache, Entry.Key);
+		if(!FindPartitionAsset(PartitionPackageName))
+		{
+			Changed.AddUnique(Entry.Key);
 		}
-		else if(Spans[i].Min < Edge.MinExtent && Spans[i].Max > Edge.MinExtent)
+		if(Entry.Value.Mesh.IsValidOrFixable())
 		{
-			Rects.Add(CreateSpanRect(Spans[i], CurValue));
+			Current.Add(PartitionPackageName);
+		}
+	}
 
-			// Contract the span
-			Spans[i].Start = CurValue;
-			Spans[i].Max = Edge.MinExtent;
+	FScopedTransaction Trans(TEXT("InteriorEditor"), FText::FromString(TEXT("Generate Static Meshes")), Graph);
+	Graph->GetLevel()->Modify();
+
+	TMap< UStaticMesh*, TArray< AStaticMeshActor* > > MeshActors;
+	for(TActorIterator< AStaticMeshActor > It(World); It; ++It)
+	{
+		auto SM = It->GetStaticMeshComponent()->StaticMesh;
+		if(SM)
+		{
+			MeshActors.FindOrAdd(SM).Add(*It);
 		}
-		else if(Spans[i].Min < Edge.MaxExtent && Spans[i].Max > Edge.MaxExtent)
+	}
+
+	auto bSuccess = true;
+	for(auto const& Coord : Changed)
+	{
+		auto const PartitionPackageName = GetPartitionPackageName(*Cache, Coord);
+		auto Section = Cache->GetSections().Find(Coord);
+		if(Section && Section->Mesh.IsValidOrFixable())
 		{
-			Rects.Add(CreateSpanRect(Spans[i], CurValue));
+			// Centre the asset on its own geometry, so its pivot and bounds are local to the partition
+			auto Raw = Section->Mesh;
+			auto const Centre = FBox(Raw.VertexPositions).GetCenter();
+			for(auto& Pos : Raw.VertexPositions)
+			{
+				Pos -= Centre;
+			}
 
-			// Contract the span
-			Spans[i].Start = CurValue;
-			Spans[i].Min = Edge.MaxExtent;
+			auto CollisionBoxes = Section->CollisionBoxes;
+			for(auto& Box : CollisionBoxes)
+			{
+				Box = Box.ShiftBy(-Centre);
+			}
+
+			auto SM = CreateSMAsset(Raw, PartitionPackageName, CollisionThickness > 0.f ? &CollisionBoxes : nullptr);
+			if(SM)
+			{
+				PlacePartitionActors(Graph, MeshActors, SM, Centre);
+			}
+			bSuccess &= SM != nullptr && SaveStreamedPart(SM);
 		}
 	}
 
-	check(Rects.Num() > 0);
-	return Rects;
+	RemoveStalePartitions(Graph, MeshActors, PackageName, Current);
+
+	return bSuccess;
+}
+
+/*
+Bytes allocated by the mesh's arrays.
+*/
+SIZE_T GetRawMeshAllocatedSize(FRawMesh const& Mesh)
+{
+	auto Size = Mesh.VertexPositions.GetAllocatedSize() +
+		Mesh.WedgeIndices.GetAllocatedSize() +
+		Mesh.WedgeTangentX.GetAllocatedSize() +
+		Mesh.WedgeTangentY.GetAllocatedSize() +
+		Mesh.WedgeTangentZ.GetAllocatedSize() +
+		Mesh.WedgeColors.GetAllocatedSize() +
+		Mesh.FaceMaterialIndices.GetAllocatedSize() +
+		Mesh.FaceSmoothingMasks.GetAllocatedSize();
+	for(auto const& TexCoords : Mesh.WedgeTexCoords)
+	{
+		Size += TexCoords.GetAllocatedSize();
+	}
+	return Size;
 }
 
-bool ConvertInteriorGraphToRawMesh(AInteriorGraphActor* Graph, FRawMesh& Mesh)
+/*
+Appends the geometry of Src to Dest.
+*/
+void AppendRawMesh(FRawMesh& Dest, FRawMesh const& Src)
 {
-	auto const TexRepeatUnits = 100.f;
+	auto const VertexBase = Dest.VertexPositions.Num();
+	Dest.VertexPositions.Append(Src.VertexPositions);
+	Dest.WedgeIndices.Reserve(Dest.WedgeIndices.Num() + Src.WedgeIndices.Num());
+	for(auto VIdx : Src.WedgeIndices)
+	{
+		Dest.WedgeIndices.Add(VertexBase + VIdx);
+	}
+	Dest.WedgeTexCoords[0].Append(Src.WedgeTexCoords[0]);
+	Dest.FaceMaterialIndices.Append(Src.FaceMaterialIndices);
+	Dest.FaceSmoothingMasks.Append(Src.FaceSmoothingMasks);
+}
 
-	enum MatTypes { Floor, Wall, Ceiling };
+FString GetStreamedPartPackageName(FString const& PackageName, int32 Part)
+{
+	return FString::Printf(TEXT("%s_Part%d"), *PackageName, Part);
+}
 
-	Mesh.Empty();
 
-	TArray< FVector > VertexPositions;
+/*
+Saves a streamed part's package, then drops the in-memory copy of the mesh's source data, which the saved package
+holds. The render data stays loaded, as the placed actors display it. The part is not meant to be edited until it has
+been loaded again, generating again simply rewrites it.
+*/
+bool SaveStreamedPart(UStaticMesh* SM)
+{
+	auto Pkg = SM->GetOutermost();
+	auto const File = FPackageName::LongPackageNameToFilename(Pkg->GetName(), FPackageName::GetAssetPackageExtension());
+	if(!GEditor->SavePackage(Pkg, SM, RF_Standalone, *File, GWarn))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Failed to save interior mesh part %s."), *Pkg->GetName());
+		return false;
+	}
 
-	auto NodeIds = Graph->GetAllNodes();
-	for(auto NId : NodeIds)
+	FRawMesh Empty;
+	for(auto& Model : SM->SourceModels)
 	{
-		auto const& Nd = Graph->GetNodeData(NId);
+		Model.RawMeshBulkData->SaveRawMesh(Empty);
+	}
+	return true;
+}
+
 
-		for(EAxisIndex Axis : FAxisUtils::AllAxes)
+/*
+Accumulates converted node batches into a mesh, writing it out as a new placed asset (PackageName_Part<N>) each time
+its raw data reaches the memory limit. Each part is saved as soon as it is written, and its source data released, so
+that only render data accumulates with the size of the graph.
+*/
+class FInteriorMeshStreamWriter
+{
+public:
+	FInteriorMeshStreamWriter(AInteriorGraphActor* InGraph, FString const& InPackageName, SIZE_T InMemoryLimit):
+		Graph(InGraph),
+		PackageName(InPackageName),
+		MemoryLimit(InMemoryLimit),
+		NumParts(0),
+		bSuccess(true),
+		Trans(TEXT("InteriorEditor"), FText::FromString(TEXT("Generate Static Meshes")), InGraph)
+	{
+		Graph->GetLevel()->Modify();
+		for(TActorIterator< AStaticMeshActor > It(Graph->GetWorld()); It; ++It)
 		{
-			for(EAxisDirection Dir : FAxisUtils::BothDirections)
+			auto SM = It->GetStaticMeshComponent()->StaticMesh;
+			if(SM)
 			{
-				auto const PA1 = FAxisUtils::OtherAxes[Axis][0];
-				auto const PA2 = FAxisUtils::OtherAxes[Axis][1];
-
-				// TODO: This ordering is currently assumed by below generation function call.
-				// Better to let the function decide, and return the ordering.
-				auto const LongAx = PA1;
-				auto const LatAx = PA2;
-				/*
-				Traverse along the first planar axis (PA1) and find all portal edges in the second planar axis (PA2)
-				*/
-				auto CombinedEdges = GeneratePortalEdges(Graph, NId, FFaceId{ Axis, Dir });
-
-				float LongBase = Nd.Min[LongAx];
-				TArray< FSpan > ActiveSpans;
-				ActiveSpans.Add(FSpan{ Nd.Min[LatAx], Nd.Max[LatAx], LongBase });
-
-				TArray< FBox2D > Rects;
-
-				// Iterate over the combined edges in order (progressing longitudinally)
-				for(int i = 0; i < CombinedEdges.Num(); ++i)
-				{
-					auto const& CEdge = CombinedEdges[i];
-					switch(CEdge.Type)
-					{
-						case FCombinedPortalEdgeInfo::End:
-						{
-							// End of portal(s), merge together active spans separated by the portals that just ended
-							for(auto const& Edge : CEdge.Edges)
-							{
-								auto ResultingRects = MergeSpans(ActiveSpans, Edge, CEdge.AxisValue);
-								Rects.Append(ResultingRects);
-							}
-						}
-						break;
+				MeshActors.FindOrAdd(SM).Add(*It);
+			}
+		}
+	}
 
-						case FCombinedPortalEdgeInfo::Begin:
-						{
-							// Portal begins. Some spans will need to be modified or split.
-							for(auto const& Edge : CEdge.Edges)
-							{
-								auto ResultingRects = SplitOrContractSpans(ActiveSpans, Edge, CEdge.AxisValue);
-								Rects.Append(ResultingRects);
-							}
-						}
-						break;
-					}
-				}
+	void Add(TArray< FConversionNode > const& Batch)
+	{
+		ConvertNodesToRawMesh(Batch, BatchMesh, Graph->bBoxCollision ? &BatchBoxes : nullptr, Graph->CollisionThickness);
+		AppendRawMesh(Mesh, BatchMesh);
+		CollisionBoxes.Append(BatchBoxes);
 
-				// Should be a single remaining active span, which needs closing off
-				check(ActiveSpans.Num() == 1);
-				Rects.Add(CreateSpanRect(ActiveSpans[0], Nd.Max[LongAx]));
+		if(GetRawMeshAllocatedSize(Mesh) + CollisionBoxes.GetAllocatedSize() >= MemoryLimit)
+		{
+			Flush();
+		}
+	}
 
-				for(auto const& Rc : Rects)
-				{
-					if(FMath::IsNearlyZero(Rc.GetSize().X, Epsilon) ||
-						FMath::IsNearlyZero(Rc.GetSize().Y, Epsilon))
-					{
-						continue;
-					}
+	/*
+	Writes out whatever remains, and removes the actors of any parts left over from a previous, larger generation, or
+	from a different partitioning.
+	Returns whether every part was written successfully.
+	*/
+	bool Finish()
+	{
+		Flush();
 
-					FBox Box3D;
-					Box3D.Min[PA1] = Rc.Min[0];
-					Box3D.Min[PA2] = Rc.Min[1];
-					Box3D.Min[Axis] = Nd.FaceAxisValue(Axis, Dir);
-					Box3D.Max[PA1] = Rc.Max[0];
-					Box3D.Max[PA2] = Rc.Max[1];
-					Box3D.Max[Axis] = Nd.FaceAxisValue(Axis, Dir);
-
-					FVector Planar1 = FVector::ZeroVector;
-					Planar1[PA1] = Box3D.Max[PA1] - Box3D.Min[PA1];
-					FVector Planar2 = FVector::ZeroVector;
-					Planar2[PA2] = Box3D.Max[PA2] - Box3D.Min[PA2];
-					if(Dir == EAxisDirection::Negative)
-					{
-						Swap(Planar1, Planar2);
-					}
+		TSet< FString > Current;
+		for(int32 Part = 0; Part < NumParts; ++Part)
+		{
+			Current.Add(GetStreamedPartPackageName(PackageName, Part));
+		}
+		RemoveStalePartitions(Graph, MeshActors, PackageName, Current);
 
+		return bSuccess;
+	}
 
-					auto VertexBase = VertexPositions.Num();
-					VertexPositions.Add(Box3D.Min);
-					VertexPositions.Add(Box3D.Min + Planar2);
-					VertexPositions.Add(Box3D.Max);
-					VertexPositions.Add(Box3D.Min + Planar1);
-
-					auto FaceMaskIdx = (int)Axis + (Dir == EAxisDirection::Positive ? 0 : (int)EAxisIndex::Count);
-					auto MatIdx = Axis == EAxisIndex::Z ? (Dir == EAxisDirection::Positive ? MatTypes::Ceiling : MatTypes::Floor) : MatTypes::Wall;
-
-					// Ensure that texture coordinates always use V for Z if Z exists
-					auto TA1 = FMath::Min(PA1, PA2);
-					auto TA2 = FMath::Max(PA1, PA2);
-//					auto TA1 = Axis == EAxisIndex::Z ? PA1 : (Axis == EAxisIndex::X ? EAxisIndex::Y : EAxisIndex::X);
-//					auto TA2 = Axis == EAxisIndex::Z ? PA2 : EAxisIndex::Z;
-
-					Mesh.FaceMaterialIndices.Add(MatIdx);
-					Mesh.FaceSmoothingMasks.Add(1 << FaceMaskIdx);
-					auto VIdx = VertexBase + 0;
-					Mesh.WedgeIndices.Add(VIdx);
-					Mesh.WedgeTexCoords[0].Add(FVector2D{ VertexPositions[VIdx][TA1], VertexPositions[VIdx][TA2] });
-					VIdx = VertexBase + 2;
-					Mesh.WedgeIndices.Add(VIdx);
-					Mesh.WedgeTexCoords[0].Add(FVector2D{ VertexPositions[VIdx][TA1], VertexPositions[VIdx][TA2] });
-					VIdx = VertexBase + 1;
-					Mesh.WedgeIndices.Add(VIdx);
-					Mesh.WedgeTexCoords[0].Add(FVector2D{ VertexPositions[VIdx][TA1], VertexPositions[VIdx][TA2] });
-					Mesh.FaceMaterialIndices.Add(MatIdx);
-					Mesh.FaceSmoothingMasks.Add(1 << FaceMaskIdx);
-					VIdx = VertexBase + 0;
-					Mesh.WedgeIndices.Add(VIdx);
-					Mesh.WedgeTexCoords[0].Add(FVector2D{ VertexPositions[VIdx][TA1], VertexPositions[VIdx][TA2] });
-					VIdx = VertexBase + 3;
-					Mesh.WedgeIndices.Add(VIdx);
-					Mesh.WedgeTexCoords[0].Add(FVector2D{ VertexPositions[VIdx][TA1], VertexPositions[VIdx][TA2] });
-					VIdx = VertexBase + 2;
-					Mesh.WedgeIndices.Add(VIdx);
-					Mesh.WedgeTexCoords[0].Add(FVector2D{ VertexPositions[VIdx][TA1], VertexPositions[VIdx][TA2] });
-				}
+protected:
+	void Flush()
+	{
+		// Batches were welded individually, but share vertices along their borders
+		WeldVertices(Mesh, Epsilon);
+		if(Mesh.IsValidOrFixable())
+		{
+			// Centre in place, since the mesh is discarded afterwards anyway
+			auto const Centre = FBox(Mesh.VertexPositions).GetCenter();
+			for(auto& Pos : Mesh.VertexPositions)
+			{
+				Pos -= Centre;
+			}
+			for(auto& Box : CollisionBoxes)
+			{
+				Box = Box.ShiftBy(-Centre);
+			}
+
+			auto SM = CreateSMAsset(Mesh, GetStreamedPartPackageName(PackageName, NumParts), Graph->bBoxCollision ? &CollisionBoxes : nullptr);
+			if(SM)
+			{
+				PlacePartitionActors(Graph, MeshActors, SM, Centre);
 			}
+			bSuccess &= SM != nullptr && SaveStreamedPart(SM);
+			++NumParts;
 		}
+
+		Mesh.Empty();
+		CollisionBoxes.Empty();
 	}
 
-	// TODO: Merging, as in StaticMeshEdit.cpp
-	Mesh.VertexPositions = VertexPositions;
+protected:
+	AInteriorGraphActor* Graph;
+	FString PackageName;
+	SIZE_T MemoryLimit;
+	TMap< UStaticMesh*, TArray< AStaticMeshActor* > > MeshActors;
+
+	FRawMesh Mesh;
+	TArray< FBox > CollisionBoxes;
+	// Scratch for the batch being added
+	FRawMesh BatchMesh;
+	TArray< FBox > BatchBoxes;
+
+	int32 NumParts;
+	bool bSuccess;
+	// Actors are placed and removed as parts are written
+	FScopedTransaction Trans;
+};
+
+// Number of nodes converted at a time by streamed conversion
+auto const StreamBatchNodes = 256;
 
-	for(auto& Tex : Mesh.WedgeTexCoords[0])
+bool ConvertInteriorGraphToStreamedSMAssets(AInteriorGraphActor* Graph, FString const& PackageName)
+{
+	if(!Graph->GetWorld())
 	{
-		Tex /= TexRepeatUnits;
+		return false;
 	}
 
-//	Mesh.WedgeColors.Init(FColor::White, Mesh.WedgeIndices.Num());
+	// Node descriptions are small compared to the geometry generated from them, so are all gathered up front
+	TArray< FConversionNode > Nodes;
+	GatherConversionNodes(Graph, Nodes);
 
-	return Mesh.IsValidOrFixable();
-}
+	// Order the nodes by chunk, so that each part covers a spatially coherent region
+	auto const ChunkSize = Graph->MeshChunkSize;
+	Nodes.Sort([ChunkSize](FConversionNode const& A, FConversionNode const& B)
+	{
+		auto const CA = FInteriorChunkCoord::FromPosition(A.Data.Box().GetCenter(), ChunkSize);
+		auto const CB = FInteriorChunkCoord::FromPosition(B.Data.Box().GetCenter(), ChunkSize);
+		if(CA.Z != CB.Z)
+		{
+			return CA.Z < CB.Z;
+		}
+		if(CA.Y != CB.Y)
+		{
+			return CA.Y < CB.Y;
+		}
+		if(CA.X != CB.X)
+		{
+			return CA.X < CB.X;
+		}
+		return A.Id < B.Id;
+	});
 
+	FInteriorMeshStreamWriter Writer(Graph, PackageName, (SIZE_T)Graph->MeshMemoryLimit * 1024 * 1024);
+	TArray< FConversionNode > Batch;
+	for(int32 First = 0; First < Nodes.Num(); First += StreamBatchNodes)
+	{
+		Batch.Reset();
+		Batch.Append(Nodes.GetData() + First, FMath::Min(StreamBatchNodes, Nodes.Num() - First));
+		Writer.Add(Batch);
+	}
 
-UStaticMesh* CreateStaticMesh(struct FRawMesh& RawMesh, TArray<UMaterialInterface*>& Materials, UObject* InOuter, FName InName);
+	return Writer.Finish();
+}
 
 bool ConvertInteriorGraphToSMAsset(AInteriorGraphActor* Graph, FString const& PackageName)
 {
-	FRawMesh Raw;
-	if(!ConvertInteriorGraphToRawMesh(Graph, Raw))
+	if(Graph->MeshPartition == EInteriorMeshPartition::Streamed)
 	{
-		return false;
+		return ConvertInteriorGraphToStreamedSMAssets(Graph, PackageName);
+	}
+	else if(Graph->MeshPartition != EInteriorMeshPartition::Single)
+	{
+		return ConvertInteriorGraphToPartitionedSMAssets(Graph, PackageName);
 	}
 
-	FName ObjName = *FPackageName::GetLongPackageAssetName(PackageName);
-	UPackage* Pkg = CreatePackage(nullptr, *PackageName);
-	check(Pkg != nullptr);
-
-	TArray< UMaterialInterface* > Mats;
-	Mats.Add(UMaterial::GetDefaultMaterial(EMaterialDomain::MD_Surface));	//GEditor->EditorBrushMaterial);
-	Mats.Add(UMaterial::GetDefaultMaterial(EMaterialDomain::MD_Surface));
-	Mats.Add(UMaterial::GetDefaultMaterial(EMaterialDomain::MD_Surface));
-
-	UStaticMesh* SM = CreateStaticMesh(Raw, Mats, Pkg, ObjName);
-	if(!SM)
+	FRawMesh Raw;
+	TArray< FBox > CollisionBoxes;
+	if(!ConvertInteriorGraphToRawMesh(Graph, Raw, &CollisionBoxes))
 	{
 		return false;
 	}
 
-	FAssetRegistryModule::AssetCreated(SM);
-	return true;
+	return CreateSMAsset(Raw, PackageName, Graph->bBoxCollision ? &CollisionBoxes : nullptr) != nullptr;
 }
 
 
@@ -362,8 +1846,9 @@ Duplicated from Engine/Source/Editor/UnrealEd/Private/StaticMeshEdit.cpp, since
 
 /**
 * Creates a static mesh object from raw triangle data.
+* Modified to optionally use a set of boxes as collision, in place of the triangles.
 */
-UStaticMesh* CreateStaticMesh(struct FRawMesh& RawMesh, TArray<UMaterialInterface*>& Materials, UObject* InOuter, FName InName)
+UStaticMesh* CreateStaticMesh(struct FRawMesh& RawMesh, TArray<UMaterialInterface*>& Materials, UObject* InOuter, FName InName, TArray< FBox > const* CollisionBoxes)
 {
 	// Create the UStaticMesh object.
 	FStaticMeshComponentRecreateRenderStateContext RecreateRenderStateContext(FindObject<UStaticMesh>(InOuter, *InName.ToString()));
@@ -381,10 +1866,29 @@ UStaticMesh* CreateStaticMesh(struct FRawMesh& RawMesh, TArray<UMaterialInterfac
 	{
 		FMeshSectionInfo Info = StaticMesh->SectionInfoMap.Get(0, SectionIdx);
 		Info.MaterialIndex = SectionIdx;
-		Info.bEnableCollision = true;
+		Info.bEnableCollision = CollisionBoxes == nullptr;
 		StaticMesh->SectionInfoMap.Set(0, SectionIdx, Info);
 	}
 
+	if(CollisionBoxes)
+	{
+		StaticMesh->CreateBodySetup();
+		auto BodySetup = StaticMesh->BodySetup;
+		BodySetup->AggGeom.BoxElems.Empty(CollisionBoxes->Num());
+		for(auto const& Box : *CollisionBoxes)
+		{
+			auto const Size = Box.GetSize();
+			FKBoxElem Elem;
+			Elem.Center = Box.GetCenter();
+			Elem.X = Size.X;
+			Elem.Y = Size.Y;
+			Elem.Z = Size.Z;
+			BodySetup->AggGeom.BoxElems.Add(Elem);
+		}
+		BodySetup->CollisionTraceFlag = CTF_UseSimpleAsComplex;
+		BodySetup->InvalidatePhysicsData();
+	}
+
 	StaticMesh->Build();
 	StaticMesh->MarkPackageDirty();
 	return StaticMesh;
@@ -2,7 +2,125 @@
 
 #pragma once
 
+#include "InteriorGraphTypes.h"
+#include "InteriorGraphActor.h"
+#include "InteriorGraphChunkActor.h"
+#include "RawMesh.h"
 
-bool ConvertInteriorGraphToSMAsset(class AInteriorGraphActor* Graph, class FString const& PackageName);
 
+/*
+Everything the conversion needs to know about one node. Gathered up front on the game thread, so that nodes can
+then be converted independently on any thread.
+*/
+struct FConversionNode
+{
+	NodeIdType Id;
+	FNodeData Data;
+	// Portals of all connections into or out of the node
+	TArray< FBox > Portals;
+	// Regions of the node's faces for which no geometry is needed: those inside another node's volume, and, if
+	// culling shared faces, those shared with touching nodes
+	TArray< FBox > HiddenAreas;
+	// Regions of the node's faces shared with touching nodes, when not culled
+	TArray< FBox > SharedAreas;
+};
+
+
+/*
+Converted geometry of one partition of a graph.
+*/
+struct FInteriorMeshSection
+{
+	FRawMesh Mesh;
+	// Slabs behind each merged rect of the mesh, for use as simple collision
+	TArray< FBox > CollisionBoxes;
+};
+
+
+/*
+Retained state for incremental conversion of a graph into one mesh section per partition.
+In grid mode, nodes belong to the cubic chunk containing their centre. In per-node mode, each node is a partition of
+its own, identified by coordinate (node id, 0, 0).
+*/
+class FInteriorMeshConversionCache
+{
+public:
+	/*
+	Collision boxes are generated with the given slab thickness, or not at all if it is 0.
+	*/
+	FInteriorMeshConversionCache(
+		EInteriorMeshPartition::Type InPartition,
+		float InChunkSize,
+		FString const& InPackageName,
+		float InCollisionThickness
+		);
+
+	/*
+	Brings the sections up to date with the graph. Only partitions containing a node which has been added, removed
+	or has changed in a way affecting its geometry (including its portals, or the touching nodes hiding its faces)
+	are reconverted. Returns the partitions whose section changed, which may now be absent if they no longer
+	contain nodes.
+	*/
+	TArray< FInteriorChunkCoord > Update(class AInteriorGraphActor const* Graph);
+
+	inline EInteriorMeshPartition::Type GetPartition() const
+	{
+		return Partition;
+	}
+
+	inline float GetChunkSize() const
+	{
+		return ChunkSize;
+	}
 
+	inline FString const& GetPackageName() const
+	{
+		return PackageName;
+	}
+
+	inline float GetCollisionThickness() const
+	{
+		return CollisionThickness;
+	}
+
+	inline TMap< FInteriorChunkCoord, FInteriorMeshSection > const& GetSections() const
+	{
+		return Sections;
+	}
+
+protected:
+	FInteriorChunkCoord PartitionOf(FConversionNode const& Node) const;
+
+protected:
+	EInteriorMeshPartition::Type Partition;
+	float ChunkSize;
+	// Base name of the assets generated from the sections
+	FString PackageName;
+	float CollisionThickness;
+	TMap< FInteriorChunkCoord, FInteriorMeshSection > Sections;
+	// Everything each node's geometry was last generated from
+	TMap< NodeIdType, FConversionNode > Nodes;
+};
+
+
+/*
+Optionally also outputs simple collision boxes for the mesh.
+*/
+bool ConvertInteriorGraphToRawMesh(class AInteriorGraphActor* Graph, FRawMesh& Mesh, TArray< FBox >* OutCollisionBoxes = nullptr);
+/*
+Generates static mesh assets from the graph, partitioned according to its MeshPartition setting.
+When partitioned, assets are named PackageName_X_Y_Z (grid), PackageName_Node<Id> or PackageName_Part<N> (streamed),
+are centred on their own geometry, and are placed in the graph's level by static mesh actors positioned to match.
+For grid and per-node partitioning, the graph's conversion cache is used so that only the assets and actors of
+partitions affected by edits since the last call are updated. Streamed conversion rewrites every part each time.
+*/
+bool ConvertInteriorGraphToSMAsset(class AInteriorGraphActor* Graph, class FString const& PackageName);
+/*
+Whether Name is that of a partition asset generated from PackageName, by any of the partitioning modes.
+*/
+bool IsPartitionPackageName(FString const& Name, FString const& PackageName);
+/*
+Frees the scratch kept by each thread which has converted nodes. Only for module shutdown, when no conversion can be
+running, since the scratch can't be used afterwards.
+*/
+void ReleaseConversionScratch();
@@ -11,6 +11,7 @@
 #include "InteriorPortalSelectionProxy.h"
 #include "InteriorEditorModeSettings.h"
 #include "InteriorEditorConversion.h"
+#include "InteriorMeshRenderingComponent.h"
 #include "SInteriorEditor.h"
 #include "SCreateAssetFromObject.h"
 #include "Editor/UnrealEd/Public/Toolkits/ToolkitManager.h"
@@ -31,6 +32,8 @@ FInteriorEditorMode::FInteriorEditorMode()
 {
 	Graph = nullptr;
 //	Gizmo = nullptr;
+	bTracking = false;
+	bPreviewPending = false;
 	
 /*	SelectionProxy = NewNamedObject< UInteriorNodeSelectionProxy >(
 		GetTransientPackage(), TEXT("NodeSelProxy"));
@@ -112,7 +115,7 @@ void FInteriorEditorMode::Exit()
 	ClearSelection();
 	GEditor->SelectNone(false, true);
 
-	Redraw();
+	Redraw(false);
 
 	FEdMode::Exit();
 }
@@ -140,6 +143,23 @@ bool FInteriorEditorMode::DisallowMouseDeltaTracking() const
 	return false;// true;
 }
 
+bool FInteriorEditorMode::StartTracking(FEditorViewportClient* InViewportClient, FViewport* InViewport)
+{
+	bTracking = true;
+	return FEdMode::StartTracking(InViewportClient, InViewport);
+}
+
+bool FInteriorEditorMode::EndTracking(FEditorViewportClient* InViewportClient, FViewport* InViewport)
+{
+	bTracking = false;
+	if(bPreviewPending)
+	{
+		// Everything changed during the drag is reconverted at once
+		Redraw();
+	}
+	return FEdMode::EndTracking(InViewportClient, InViewport);
+}
+
 bool FInteriorEditorMode::UsesTransformWidget(FWidget::EWidgetMode InWidgetMode) const
 {
 	switch(InWidgetMode)
@@ -238,7 +258,7 @@ bool FInteriorEditorMode::HandleClick(FEditorViewportClient* InViewport, HHitPro
 				if(Click.IsControlDown())
 				{
 					Deselect(HP);
-					Redraw();
+					Redraw(false);
 				}
 				else
 				{
@@ -264,14 +284,14 @@ bool FInteriorEditorMode::HandleClick(FEditorViewportClient* InViewport, HHitPro
 				}
 
 				Select(HP);
-				Redraw();
+				Redraw(false);
 			}
 			return true;
 		}
 		else
 		{
 			ClearSelection();
-			Redraw();
+			Redraw(false);
 			return true;
 		}
 	}
@@ -958,11 +978,29 @@ bool FInteriorEditorMode::TryAddPortal(NodeIdType N1, NodeIdType N2)
 	}
 }
 
-void FInteriorEditorMode::Redraw() const
+void FInteriorEditorMode::Redraw(bool bGraphChanged) const
 {
 	if(Graph)
 	{
 		Graph->GetRootComponent()->MarkRenderStateDirty();
+
+		if(!bGraphChanged)
+		{
+			return;
+		}
+
+		if(bTracking)
+		{
+			bPreviewPending = true;
+			return;
+		}
+
+		bPreviewPending = false;
+		auto MeshComp = Graph->FindComponentByClass< UInteriorMeshRenderingComponent >();
+		if(MeshComp)
+		{
+			MeshComp->UpdatePreview();
+		}
 	}
 }
 
@@ -1348,7 +1386,7 @@ void FInteriorEditorMode::ClearSelection(SelectionType ST)
 	if(bChanged)
 	{
 		GEditor->NoteSelectionChange();
-		Redraw();
+		Redraw(false);
 	}
 }
 
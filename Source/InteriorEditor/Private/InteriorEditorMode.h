@@ -36,6 +36,8 @@ public:
 	virtual void ActorMoveNotify() override;
 	virtual bool AllowWidgetMove() override;
 	virtual bool DisallowMouseDeltaTracking() const override;
+	virtual bool StartTracking(FEditorViewportClient* InViewportClient, FViewport* InViewport) override;
+	virtual bool EndTracking(FEditorViewportClient* InViewportClient, FViewport* InViewport) override;
 	virtual bool UsesTransformWidget(FWidget::EWidgetMode InWidgetMode) const override;
 	virtual bool ShouldDrawWidget() const override;
 	virtual EAxisList::Type GetWidgetAxisToDraw(FWidget::EWidgetMode InWidgetMode) const override;
@@ -212,7 +214,11 @@ protected:
 
 	bool TryAddPortal(NodeIdType N1, NodeIdType N2);
 
-	void Redraw() const;
+	/*
+	Refreshes the graph's drawing. The mesh preview is only updated if the graph itself may have changed, and during a
+	widget drag is held back until the drag ends.
+	*/
+	void Redraw(bool bGraphChanged = true) const;
 
 	void OnGenerateNamedStaticMesh(FString const& PkgName) const;
 
@@ -224,6 +230,9 @@ protected:
 	FaceList SelectedFaces;
 	PortalList SelectedPortals;
 
+	bool bTracking;
+	mutable bool bPreviewPending;
+
 	TArray< class UInteriorNodeSelectionProxy* > NodeSelectionProxies;
 	TArray< class UInteriorFaceSelectionProxy* > FaceSelectionProxies;
 	TArray< class UInteriorPortalSelectionProxy* > PortalSelectionProxies;
@@ -3,11 +3,21 @@
 #include "InteriorEditorPrivatePCH.h"
 #include "InteriorGraphActor.h"
 #include "InteriorGraphInstance.h"
+#include "InteriorGraphBuildState.h"
+#include "InteriorGraphBuildTask.h"
+#include "InteriorGraphCache.h"
+#include "InteriorGraphBlob.h"
+#include "InteriorGraphChunking.h"
+#include "InteriorStoredGraphActor.h"
+#include "InteriorGraphCustomVersion.h"
+#include "InteriorGraphRecords.h"
 #include "InteriorEditorUtil.h"
 #include "InteriorEditorNodeFace.h"
 #include "Engine/World.h"
+#include "EngineUtils.h"
 #include "VisibilityHelpers.h"
 #include "InteriorGraphRenderingComponent.h"
+#include "InteriorMeshRenderingComponent.h"
 
 #include <algorithm>
 
@@ -38,31 +48,48 @@ inline bool operator== (FConnectionData const& Conn, FConnectionKey const& Key)
 
 
 AInteriorGraphActor::AInteriorGraphActor():
+bCompactSerialization(true),
+bCullSharedFaces(false),
+MeshPartition(EInteriorMeshPartition::Single),
+MeshChunkSize(2000.f),
+MeshMemoryLimit(256),
+bPreviewMesh(false),
+bBoxCollision(true),
+CollisionThickness(10.f),
 NextNodeId(0),
-NextConnectionId(0)
+NextConnectionId(0),
+bIdentityIds(true),
+BuildGeneration(0),
+StoredGraphActor(nullptr)
 {
 	RootComponent = CreateEditorOnlyDefaultSubobject< UInteriorGraphRenderingComponent >(TEXT("RenderComp"));
+
+	auto MeshComp = CreateEditorOnlyDefaultSubobject< UInteriorMeshRenderingComponent >(TEXT("MeshPreviewComp"));
+	if(MeshComp)
+	{
+		MeshComp->AttachParent = RootComponent;
+	}
 }
 
 NodeIdList AInteriorGraphActor::GetAllNodes() const
 {
 	NodeIdList Ids;
-	Ids.Reserve(NodeMap.Num());
-	for(auto const& Entry: NodeMap)
+	Ids.Reserve(NumNodes());
+	ForEachNode([&Ids](NodeIdType Id, int32 Idx)
 	{
-		Ids.Add(Entry.Key);
-	}
+		Ids.Add(Id);
+	});
 	return Ids;
 }
 
 ConnectionIdList AInteriorGraphActor::GetAllConnections() const
 {
 	ConnectionIdList Ids;
-	Ids.Reserve(ConnectionMap.Num());
-	for(auto const& Entry : ConnectionMap)
+	Ids.Reserve(NumConnections());
+	ForEachConnection([&Ids](ConnectionIdType Id, int32 Idx)
 	{
-		Ids.Add(Entry.Key);
-	}
+		Ids.Add(Id);
+	});
 	return Ids;
 }
 
@@ -80,7 +107,7 @@ NodeIdList AInteriorGraphActor::GetAdjacentNodes(NodeIdType src) const
 FNodeData const& AInteriorGraphActor::GetNodeData(NodeIdType id) const
 {
 #if WITH_EDITOR
-	return NodeData[NodeMap[id]];
+	return NodeData[NodeIndex(id)];
 #else
 	return NodeData[id];
 #endif
@@ -89,7 +116,7 @@ FNodeData const& AInteriorGraphActor::GetNodeData(NodeIdType id) const
 FConnectionData const& AInteriorGraphActor::GetConnectionData(ConnectionIdType id) const
 {
 #if WITH_EDITOR
-	return ConnData[ConnectionMap[id]];
+	return ConnData[ConnectionIndex(id)];
 #else
 	return ConnData[id];
 #endif
@@ -98,7 +125,7 @@ FConnectionData const& AInteriorGraphActor::GetConnectionData(ConnectionIdType i
 FNodeData& AInteriorGraphActor::GetNodeDataRef(NodeIdType id)
 {
 #if WITH_EDITOR
-	return NodeData[NodeMap[id]];
+	return NodeData[NodeIndex(id)];
 #else
 	return NodeData[id];
 #endif
@@ -107,7 +134,7 @@ FNodeData& AInteriorGraphActor::GetNodeDataRef(NodeIdType id)
 FConnectionData& AInteriorGraphActor::GetConnectionDataRef(ConnectionIdType id)
 {
 #if WITH_EDITOR
-	return ConnData[ConnectionMap[id]];
+	return ConnData[ConnectionIndex(id)];
 #else
 	return ConnData[id];
 #endif
@@ -134,13 +161,13 @@ ConnectionIdList AInteriorGraphActor::GetNodeOutConnections(NodeIdType id) const
 ConnectionIdList AInteriorGraphActor::GetNodeInConnections(NodeIdType id) const
 {
 	ConnectionIdList In;
-	for(auto const& Cn : ConnectionMap)
+	ForEachConnection([this, id, &In](ConnectionIdType CId, int32 Idx)
 	{
-		if(GetConnectionData(Cn.Value).Dest == id)
+		if(ConnData[Idx].Dest == id)
 		{
-			In.Add(Cn.Key);
+			In.Add(CId);
 		}
-	}
+	});
 	return In;
 }
 
@@ -149,14 +176,14 @@ ConnectionIdList AInteriorGraphActor::GetAllNodeConnections(NodeIdType id) const
 //	auto List = GetNodeOutConnections(id);
 //	List += GetNodeInConnections(id);
 	auto List = ConnectionIdList{};
-	for(auto const& Cn : ConnectionMap)
+	ForEachConnection([this, id, &List](ConnectionIdType CId, int32 Idx)
 	{
-		if(GetConnectionData(Cn.Value).Src == id ||
-			GetConnectionData(Cn.Value).Dest == id)
+		if(ConnData[Idx].Src == id ||
+			ConnData[Idx].Dest == id)
 		{
-			List.AddUnique(Cn.Key);
+			List.AddUnique(CId);
 		}
-	}
+	});
 	return List;
 }
 
@@ -195,7 +222,15 @@ NodeIdType AInteriorGraphActor::AddNode(FVector const& Min, FVector const& Max)
 
 	auto Idx = NodeData.Add(Nd);
 	auto Id = NextNodeId++;
-	NodeMap.Add(Id, Idx);
+	if(bIdentityIds)
+	{
+		check(Idx == Id);
+	}
+	else
+	{
+		NodeMap.Add(Id, Idx);
+	}
+	MarkNodeDirty(Id);
 
 #if WITH_EDITOR
 	FString Nm = TEXT("Node ");
@@ -243,12 +278,14 @@ void AInteriorGraphActor::SetNodeData(NodeIdType id, FNodeData&& ND)
 {
 	auto& Node = GetNodeDataRef(id);
 	Node = std::move(ND);
+	MarkNodeDirty(id);
 }
 
 void AInteriorGraphActor::SetConnectionData(ConnectionIdType id, FConnectionData&& CD)
 {
 	auto& Conn = GetConnectionDataRef(id);
 	Conn = std::move(CD);
+	MarkConnectionDirty(id);
 }
 
 #if 0
@@ -282,71 +319,117 @@ bool AInteriorGraphActor::ToggleConnection(class AInteriorNodeActor* N1, class A
 }
 #endif
 
-void AInteriorGraphActor::RemoveHiddenNodes(
-	TMap< NodeIdType, FNodeData >& BuildND,
-	TMap< ConnectionIdType, FConnectionData >& BuildCD,
-	UWorld* World
-	)
+void AInteriorGraphActor::MarkNodeDirty(NodeIdType Id)
 {
-	for(auto It = BuildND.CreateIterator(); It; ++It)
-	{
-		auto& ND = It->Value;
-		auto Pos = ND.Center();
-		auto Hidden = UVisibilityHelpers::IsPointHidden(Pos, World, ECollisionChannel::ECC_WorldStatic);
+	DirtyNodes.Add(Id);
+	ClearStoredGraph();
+}
 
-		if(Hidden)
-		{
-			for(auto Out : ND.Outgoing)
-			{
-				BuildCD.Remove(Out);
-			}
+void AInteriorGraphActor::MarkConnectionDirty(ConnectionIdType Id)
+{
+	DirtyConnections.Add(Id);
+	ClearStoredGraph();
+}
 
-			It.RemoveCurrent();
-		}
-	}
+int32 AInteriorGraphActor::NodeIndex(NodeIdType Id) const
+{
+	return bIdentityIds ? Id : NodeMap.FindChecked(Id);
 }
 
-void AInteriorGraphActor::PackNodeAndConnectionData(
-	TSharedPtr< FInteriorGraphInstance > Inst,
-	TMap< NodeIdType, FNodeData >& BuildND,
-	TMap< ConnectionIdType, FConnectionData >& BuildCD
-	)
+int32 AInteriorGraphActor::ConnectionIndex(ConnectionIdType Id) const
 {
-	TMap< NodeIdType, NodeIdType > NodeCondense;
-	TMap< ConnectionIdType, ConnectionIdType > ConnCondense;
+	return bIdentityIds ? Id : ConnectionMap.FindChecked(Id);
+}
 
-	// Sort for debugging consistency
-	BuildND.KeySort([](NodeIdType A, NodeIdType B)
+bool AInteriorGraphActor::HasNode(NodeIdType Id) const
+{
+	return bIdentityIds ? (Id >= 0 && Id < NodeData.Num()) : NodeMap.Contains(Id);
+}
+
+bool AInteriorGraphActor::HasConnection(ConnectionIdType Id) const
+{
+	return bIdentityIds ? (Id >= 0 && Id < ConnData.Num()) : ConnectionMap.Contains(Id);
+}
+
+int32 AInteriorGraphActor::NumNodes() const
+{
+	return bIdentityIds ? NodeData.Num() : NodeMap.Num();
+}
+
+int32 AInteriorGraphActor::NumConnections() const
+{
+	return bIdentityIds ? ConnData.Num() : ConnectionMap.Num();
+}
+
+void AInteriorGraphActor::MaterializeIdMaps()
+{
+	if(!bIdentityIds)
 	{
-		return A < B;
-	});
-	for(auto const& ND : BuildND)
+		return;
+	}
+
+	NodeMap.Empty(NodeData.Num());
+	for(int32 Idx = 0; Idx < NodeData.Num(); ++Idx)
 	{
-		NodeCondense.Add(ND.Key, NodeCondense.Num());
+		NodeMap.Add(Idx, Idx);
 	}
 
-	BuildCD.KeySort([](ConnectionIdType A, ConnectionIdType B)
+	ConnectionMap.Empty(ConnData.Num());
+	for(int32 Idx = 0; Idx < ConnData.Num(); ++Idx)
 	{
-		return A < B;
-	});
-	for(auto const& CD : BuildCD)
+		ConnectionMap.Add(Idx, Idx);
+	}
+
+	bIdentityIds = false;
+}
+
+void AInteriorGraphActor::InvalidateBuildState()
+{
+	BuildState.Reset();
+	DirtyNodes.Empty();
+	DirtyConnections.Empty();
+
+	// Prevent any in-flight build from adopting its state
+	++BuildGeneration;
+}
+
+void AInteriorGraphActor::FindHiddenCells(TArray< FBox > const& Boxes, UWorld* World, TBitArray<>& OutHidden)
+{
+	OutHidden.Init(false, Boxes.Num());
+	if(!World)
 	{
-		ConnCondense.Add(CD.Key, ConnCondense.Num());
+		return;
 	}
 
-	Inst->NodeData.Init(FNodeData{}, BuildND.Num());
-	for(auto& ND : BuildND)
+	for(int32 Idx = 0; Idx < Boxes.Num(); ++Idx)
 	{
-		for(auto& Out : ND.Value.Outgoing)
-		{
-			Out = ConnCondense[Out];
-		}
+		OutHidden[Idx] = UVisibilityHelpers::IsPointHidden(Boxes[Idx].GetCenter(), World, ECollisionChannel::ECC_WorldStatic);
+	}
+}
+
+void AInteriorGraphActor::PackNodeAndConnectionData(
+	TSharedPtr< FInteriorGraphInstance > Inst,
+	TMap< NodeIdType, FNodeData > const& BuildND,
+	TMap< ConnectionIdType, FConnectionData > const& BuildCD,
+	TMap< NodeIdType, FInteriorCellOrigin > const& CellOrigins
+	)
+{
+	TMap< NodeIdType, NodeIdType > NodeCondense;
+	TMap< ConnectionIdType, ConnectionIdType > ConnCondense;
 
-		Inst->NodeData[NodeCondense[ND.Key]] = std::move(ND.Value);
+	// Sort for debugging consistency
+	TArray< NodeIdType > NodeKeys;
+	BuildND.GenerateKeyArray(NodeKeys);
+	NodeKeys.Sort();
+	NodeCondense.Empty(NodeKeys.Num());
+	for(auto Key : NodeKeys)
+	{
+		NodeCondense.Add(Key, NodeCondense.Num());
 	}
 
-	Inst->ConnData.Reset();
-	for(auto& CD : BuildCD)
+	TArray< ConnectionIdType > ConnKeys;
+	ConnKeys.Reserve(BuildCD.Num());
+	for(auto const& CD : BuildCD)
 	{
 		if(
 			!NodeCondense.Contains(CD.Value.Src) ||
@@ -357,436 +440,1627 @@ void AInteriorGraphActor::PackNodeAndConnectionData(
 			continue;
 		}
 
-		CD.Value.Src = NodeCondense[CD.Value.Src];
-		CD.Value.Dest = NodeCondense[CD.Value.Dest];
-
-		Inst->ConnData.Add(std::move(CD.Value));
+		ConnKeys.Add(CD.Key);
+	}
+	ConnKeys.Sort();
+	ConnCondense.Empty(ConnKeys.Num());
+	for(auto Key : ConnKeys)
+	{
+		ConnCondense.Add(Key, ConnCondense.Num());
 	}
 
-	//
-	TMap< NodeIdType, FString > NewNodeNames;
-	for(auto& NdNm : Inst->NodeNames)
+	Inst->NodeData.Init(FNodeData{}, NodeKeys.Num());
+	for(auto const& ND : BuildND)
 	{
-		auto Ptr = NodeCondense.Find(NdNm.Key);
-		if(Ptr)
+		auto& Packed = Inst->NodeData[NodeCondense[ND.Key]];
+		Packed.Min = ND.Value.Min;
+		Packed.Max = ND.Value.Max;
+		Packed.Outgoing.Reserve(ND.Value.Outgoing.Num());
+		for(auto Out : ND.Value.Outgoing)
 		{
-			auto MappedKey = *Ptr;
-			FString Nm = FText::Format(
-				FText::FromString(TEXT("{0}:{1}-({2})")),
-				FText::FromString(NdNm.Value),
-				FText::AsNumber(MappedKey),
-				FText::AsNumber(Inst->NodeData[MappedKey].Outgoing.Num())
-				).ToString();
-			NewNodeNames.Add(MappedKey, Nm);
+			auto Ptr = ConnCondense.Find(Out);
+			if(Ptr)
+			{
+				Packed.Outgoing.Add(*Ptr);
+			}
 		}
 	}
-	Inst->NodeNames = std::move(NewNodeNames);
-	//
-}
 
-TSharedPtr< FInteriorGraphInstance > AInteriorGraphActor::BuildGraph(int32 Subdivision, int32 SubdivisionZ)
-{
-	// Map from original Id to instance node Id
-	TMap< NodeIdType, TArray< NodeIdType > > OriginalNodeMap;
+	Inst->CellOrigins.SetNumUninitialized(NodeKeys.Num());
+	for(auto Key : NodeKeys)
+	{
+		Inst->CellOrigins[NodeCondense[Key]] = CellOrigins[Key];
+	}
 
-	TMap< NodeIdType, FNodeData > BuildND;
-	TMap< ConnectionIdType, FConnectionData > BuildCD;
-	NodeIdType NId = 0;
-	ConnectionIdType CId = 0;
+	Inst->ConnData.Reset(ConnKeys.Num());
+	for(auto Key : ConnKeys)
+	{
+		auto CD = BuildCD[Key];
+		CD.Src = NodeCondense[CD.Src];
+		CD.Dest = NodeCondense[CD.Dest];
 
-	TSharedPtr< FInteriorGraphInstance > Inst = MakeShareable(new FInteriorGraphInstance);
+		Inst->ConnData.Add(std::move(CD));
+	}
+}
 
-	for(auto const& N : NodeMap)
+bool AInteriorGraphActor::ConnectCells(
+	FInteriorGraphBuildState& State,
+	NodeIdType N1,
+	NodeIdType N2,
+	FAxisAlignedPlanarArea const& Area,
+	TArray< ConnectionIdType >& OutIds
+	)
+{
+	auto SrcPtr = State.BuildND.Find(N1);
+	if(!SrcPtr || !State.BuildND.Contains(N2))
 	{
-		auto const& ND = NodeData[N.Value];
-
-		auto SubExtent = ND.Size() * FVector(1.f / Subdivision, 1.f / Subdivision, 1.f / SubdivisionZ);
-		auto Base = ND.Min;
+		return false;
+	}
 
-		OriginalNodeMap.Add(N.Key, TArray < NodeIdType > {});
+	auto CId = State.NextConnectionId++;
+	State.BuildCD.Add(CId, FConnectionData{ N1, N2, FBox{ Area.Min, Area.Max } });
+	SrcPtr->Outgoing.Add(CId);
+	OutIds.Add(CId);
+	return true;
+}
 
-		auto IdxBase = BuildND.Num();
-		for(int32 x = 0; x < Subdivision; ++x)
+void AInteriorGraphActor::RemoveCellConnection(FInteriorGraphBuildState& State, ConnectionIdType CId)
+{
+	auto CDPtr = State.BuildCD.Find(CId);
+	if(CDPtr)
+	{
+		auto SrcPtr = State.BuildND.Find(CDPtr->Src);
+		if(SrcPtr)
 		{
-			for(int32 y = 0; y < Subdivision; ++y)
-			{
-				for(int32 z = 0; z < SubdivisionZ; ++z)
-				{
-					auto NData = FNodeData{
-						Base + SubExtent * FVector(x, y, z),
-						Base + SubExtent * FVector(x + 1, y + 1, z + 1)
-					};
-					BuildND.Add(NId, NData);
-
-					FString Nm = NodeNames[N.Key];
-					Nm += FText::Format(
-						FText::FromString(TEXT("[{0}][{1}][{2}]")),
-						FText::AsNumber(x),
-						FText::AsNumber(y),
-						FText::AsNumber(z)
-						).ToString();
-					Inst->NodeNames.Add(NId, Nm);
-
-					OriginalNodeMap[N.Key].Add(NId);
-
-					++NId;
-				}
-			}
+			SrcPtr->Outgoing.Remove(CId);
 		}
 
-		/* TODO:
-		for(int32 Idx = IdxBase; Idx < BuildND.Num(); ++Idx)
-		{
-			auto Offset = Idx - IdxBase;
-			auto x = Offset / Subdivision;
-			auto y = Offset % Subdivision;
-
-			// TODO: Create connection portals!!!!!!!!!!!!!!!!!
-			if(x != 0)
-			{
-				auto DstOffset = (x - 1) * Subdivision + y;
-				auto DstIdx = IdxBase + DstOffset;
-				BuildCD.Add(CId, FConnectionData{ Idx, DstIdx });
-				BuildND[Idx].Outgoing.Add(CId);
-				++CId;
-			}
-			if(x != Subdivision - 1)
-			{
-				auto DstOffset = (x + 1) * Subdivision + y;
-				auto DstIdx = IdxBase + DstOffset;
-				BuildCD.Add(CId, FConnectionData{ Idx, DstIdx });
-				BuildND[Idx].Outgoing.Add(CId);
-				++CId;
-			}
-			if(y != 0)
-			{
-				auto DstOffset = x * Subdivision + (y - 1);
-				auto DstIdx = IdxBase + DstOffset;
-				BuildCD.Add(CId, FConnectionData{ Idx, DstIdx });
-				BuildND[Idx].Outgoing.Add(CId);
-				++CId;
-			}
-			if(y != Subdivision - 1)
-			{
-				auto DstOffset = x * Subdivision + (y + 1);
-				auto DstIdx = IdxBase + DstOffset;
-				BuildCD.Add(CId, FConnectionData{ Idx, DstIdx });
-				BuildND[Idx].Outgoing.Add(CId);
-				++CId;
-			}
-		}
-		*/
+		State.BuildCD.Remove(CId);
 	}
+}
 
-/*	TODO:
-	// Now add pre-established connections
-	for(auto const& C : Connections)
-	{
-		auto const& PotentialN1 = NodeMap[C->Node1];
-		auto const& PotentialN2 = NodeMap[C->Node2];
-		auto Portal = FBox{ C->GetMin(), C->GetMax() };
+void AInteriorGraphActor::FindCellCandidates(
+	FInteriorGraphBuildSettings const& Settings,
+	FNodeData const& ND,
+	TArray< FBox > const& Portals,
+	UWorld* World,
+	FInteriorCellCandidates& OutCandidates
+	)
+{
+	OutCandidates.Boxes.Reset();
 
-		for(auto N1 : PotentialN1)
+	switch(Settings.Mode)
+	{
+		case EInteriorSubdivisionMode::Uniform:
 		{
-			FAxisAlignedPlanarArea Surf1;
-			if(TestForSharedSurface(BuildND[N1].Box(), Portal, 1.e-4f, &Surf1))
+			auto const Subdivision = Settings.Subdivision;
+			auto const SubdivisionZ = Settings.SubdivisionZ;
+			auto const SubExtent = ND.Size() * FVector(1.f / Subdivision, 1.f / Subdivision, 1.f / SubdivisionZ);
+			auto const Base = ND.Min;
+
+			// In grid order, so that a box's index gives its grid coordinates
+			OutCandidates.Boxes.Reserve(Subdivision * Subdivision * SubdivisionZ);
+			for(int32 x = 0; x < Subdivision; ++x)
 			{
-				for(auto N2 : PotentialN2)
+				for(int32 y = 0; y < Subdivision; ++y)
 				{
-					FAxisAlignedPlanarArea Surf2;
-					if(TestForSharedSurface(BuildND[N2].Box(), Portal, 1.e-4f, &Surf2))
+					for(int32 z = 0; z < SubdivisionZ; ++z)
 					{
-						if(TestForSharedSurface(
-							FBox{ Surf1.Min, Surf1.Max },
-							FBox{ Surf2.Min, Surf2.Max },
-							1.e-4f))
-						{
-							BuildCD.Add(CId, FConnectionData{ N1, N2, });
-							BuildND[N1].Outgoing.Add(CId);
-							++CId;
-
-							BuildCD.Add(CId, FConnectionData{ N2, N1 });
-							BuildND[N2].Outgoing.Add(CId);
-							++CId;
-						}
+						OutCandidates.Boxes.Add(FBox{
+							Base + SubExtent * FVector(x, y, z),
+							Base + SubExtent * FVector(x + 1, y + 1, z + 1)
+						});
 					}
 				}
 			}
 		}
+		break;
+
+		case EInteriorSubdivisionMode::Adaptive:
+		SubdivideAdaptive(ND.Box(), Settings, Portals, World, OutCandidates.Boxes);
+		break;
 	}
-	*/
 
-	RemoveHiddenNodes(BuildND, BuildCD, GetWorld());
-	PackNodeAndConnectionData(Inst, BuildND, BuildCD);
-	return Inst;
+	FindHiddenCells(OutCandidates.Boxes, World, OutCandidates.Hidden);
 }
 
-bool AInteriorGraphActor::RemoveNode(NodeIdType Id)
+void AInteriorGraphActor::BuildNodeCells(
+	FInteriorGraphBuildState& State,
+	NodeIdType OrigId,
+	FInteriorCellCandidates const& Candidates
+	)
 {
-	if(!NodeMap.Contains(Id))
+	// Merged cells no longer lie on the grid, so go through the generic path
+	if(State.Settings.Mode == EInteriorSubdivisionMode::Uniform && !State.Settings.bMergeCells)
 	{
-		return false;
+		BuildUniformNodeCells(State, OrigId, Candidates);
 	}
-
-	// Remove all connection into and out of this node
-	auto Conns = GetAllNodeConnections(Id);
-	for(auto CId : Conns)
+	else
 	{
-		RemoveConnection(CId);
+		AddNodeCellBoxes(State, OrigId, Candidates);
 	}
-
-	// Finally, remove the node itself
-	// Note we are currently just removing the map key without condensing the array and remapping
-	NodeData[NodeMap[Id]] = FNodeData{};
-	NodeNames.Remove(Id);
-	NodeMap.Remove(Id);
-
-	return true;
 }
 
-bool AInteriorGraphActor::RemoveConnection(ConnectionIdType Id)
+void AInteriorGraphActor::BuildUniformNodeCells(
+	FInteriorGraphBuildState& State,
+	NodeIdType OrigId,
+	FInteriorCellCandidates const& Candidates
+	)
 {
-	if(!ConnectionMap.Contains(Id))
-	{
-		return false;
-	}
-
-	auto& Cn = ConnData[ConnectionMap[Id]];
-	
-	// TODO: Decide what to do with in/out and bidirectional
-	GetNodeDataRef(Cn.Src).Outgoing.Remove(Id);
-	GetNodeDataRef(Cn.Dest).Outgoing.Remove(Id);
+	auto const Subdivision = State.Settings.Subdivision;
+	auto const SubdivisionZ = State.Settings.SubdivisionZ;
 
-	Cn = FConnectionData{};
-	ConnectionMap.Remove(Id);
-	return true;
-}
+	// Cell ids are allocated as a contiguous block in grid order, so can be derived from grid coordinates
+	auto const IdBase = State.NextNodeId;
+	auto CellId = [=](int32 x, int32 y, int32 z)
+	{
+		return IdBase + (x * Subdivision + y) * SubdivisionZ + z;
+	};
+	State.NextNodeId += Candidates.Boxes.Num();
 
-ConnectionIdType AInteriorGraphActor::FindFirstConnection(FConnectionKey const& Key) const
-{
-	auto ElemPtr = ConnData.FindByPredicate(TArrayPred{ Key });
-	if(ElemPtr)
+	auto& Cells = State.OriginalNodeMap.Add(OrigId, TArray< NodeIdType >{});
+	Cells.Reserve(Candidates.Boxes.Num());
+	for(int32 Idx = 0; Idx < Candidates.Boxes.Num(); ++Idx)
 	{
-		auto Idx = ElemPtr - ConnData.GetData();
-		auto KeyPtr = ConnectionMap.FindKey(Idx);
-		check(KeyPtr);
-		return *KeyPtr;
+		if(!Candidates.Hidden[Idx])
+		{
+			Cells.Add(IdBase + Idx);
+			State.BuildND.Add(IdBase + Idx, FNodeData{ Candidates.Boxes[Idx].Min, Candidates.Boxes[Idx].Max });
+		}
 	}
 
-	return NullConnection;
-}
-
-ConnectionIdType AInteriorGraphActor::CreateConnection(
-	NodeIdType N1,
-	NodeIdType N2,
-	FAxisAlignedPlanarArea const& area)
-{
-	FConnectionData Conn;
-	Conn.Src = N1;
-	Conn.Dest = N2;
-	Conn.Portal = FBox{ area.Min, area.Max };
-
-	auto Idx = ConnData.Add(Conn);
-	auto Id = NextConnectionId++;
-	ConnectionMap.Add(Id, Idx);
+	// Connect each surviving cell to its surviving neighbours within the same original node
+	auto& Internal = State.InternalConnectionMap.Add(OrigId, TArray< ConnectionIdType >{});
+	for(int32 x = 0; x < Subdivision; ++x)
+	{
+		for(int32 y = 0; y < Subdivision; ++y)
+		{
+			for(int32 z = 0; z < SubdivisionZ; ++z)
+			{
+				auto Id = CellId(x, y, z);
+				if(!State.BuildND.Contains(Id))
+				{
+					continue;
+				}
 
-#if WITH_EDITOR
-	FString Nm = TEXT("Connection ");
-	Nm.AppendInt(Id);
-	ConnNames.Add(Id, Nm);
-#endif
+				State.CellOrigins.Add(Id, FInteriorCellOrigin{ OrigId, x, y, z });
 
-	return Id;
+				NodeIdType Neighbours[] = {
+					x + 1 < Subdivision ? CellId(x + 1, y, z) : NullNode,
+					y + 1 < Subdivision ? CellId(x, y + 1, z) : NullNode,
+					z + 1 < SubdivisionZ ? CellId(x, y, z + 1) : NullNode,
+				};
+				for(auto Adj : Neighbours)
+				{
+					FAxisAlignedPlanarArea Shared;
+					if(Adj != NullNode &&
+						State.BuildND.Contains(Adj) &&
+						TestForSharedSurface(State.BuildND[Id].Box(), State.BuildND[Adj].Box(), 1.e-4f, &Shared))
+					{
+						ConnectCells(State, Id, Adj, Shared, Internal);
+						ConnectCells(State, Adj, Id, Shared, Internal);
+					}
+				}
+			}
+		}
+	}
 }
 
-void AInteriorGraphActor::GetPackedData(
-	TArray< FNodeData >& PackedNodes,
-	TArray< FConnectionData >& PackedConnections,
-	TArray< FString >& NodeNameAr,
-	TArray< FString >& ConnNameAr
-	) const
+void AInteriorGraphActor::SubdivideAdaptive(
+	FBox const& Box,
+	FInteriorGraphBuildSettings const& Settings,
+	TArray< FBox > const& Portals,
+	UWorld* World,
+	TArray< FBox >& OutCells
+	)
 {
-	PackedNodes.Empty(NodeMap.Num());
-	PackedConnections.Empty(ConnectionMap.Num());
+	auto const Size = Box.GetSize();
 
-/*	NodeMap.KeySort([](NodeIdType A, NodeIdType B)
+	bool bCanSplit[EAxisIndex::Count];
+	bool bAnyCanSplit = false;
+	bool bTooLarge = false;
+	for(EAxisIndex Axis : FAxisUtils::AllAxes)
 	{
-		return A < B;
-	});
-*/	TMap< NodeIdType, int32 > NodeIdMap;
-	for(auto const& Nd : NodeMap)
-	{
-		NodeIdMap.Add(Nd.Key, NodeIdMap.Num());
+		bCanSplit[Axis] = Size[Axis] >= Settings.MinCellSize * 2.f;
+		bAnyCanSplit |= bCanSplit[Axis];
+		bTooLarge |= bCanSplit[Axis] && Size[Axis] > Settings.TargetCellSize;
 	}
 
-/*	ConnectionMap.KeySort([](ConnectionIdType A, ConnectionIdType B)
-	{
-		return A < B;
-	});
-*/	TMap< ConnectionIdType, int32 > ConnectionIdMap;
-	for(auto const& Cn : ConnectionMap)
+	if(!bAnyCanSplit)
 	{
-		ConnectionIdMap.Add(Cn.Key, ConnectionIdMap.Num());
+		OutCells.Add(Box);
+		return;
 	}
 
-	for(auto const& Nd : NodeMap)
+	/*
+	Cells which are no larger than the target size are still refined if they are near a portal, or only partially
+	blocked by geometry, since that is where navigation needs the extra resolution.
+	*/
+	bool bRefine = false;
+	if(!bTooLarge)
 	{
-		auto ND = NodeData[Nd.Value];
-		for(auto& Out : ND.Outgoing)
+		auto const Expanded = Box.ExpandBy(Settings.PortalRefineDistance);
+		for(auto const& Portal : Portals)
+		{
+			if(Expanded.Intersect(Portal))
+			{
+				bRefine = true;
+				break;
+			}
+		}
+
+		if(!bRefine && Settings.bRefineNearGeometry && World)
 		{
-			Out = ConnectionIdMap[Out];
+			// Shrink slightly so that geometry merely touching the cell boundary does not count
+			auto const TestExtent = Box.GetExtent() - FVector(1.f);
+			bRefine = World->OverlapTest(
+				Box.GetCenter(),
+				FQuat::Identity,
+				ECollisionChannel::ECC_WorldStatic,
+				FCollisionShape::MakeBox(TestExtent)
+				);
 		}
 
-		auto NId = PackedNodes.Add(ND);
-		NodeNameAr.Add(NodeNames[Nd.Key]);
-//		NewNodeMap.Add(NId, NId);
+		if(!bRefine)
+		{
+			OutCells.Add(Box);
+			return;
+		}
 	}
 
-	for(auto const& Cn : ConnectionMap)
+	// Halve along every axis which is either too large, or splittable when refining
+	bool bSplit[EAxisIndex::Count];
+	for(EAxisIndex Axis : FAxisUtils::AllAxes)
 	{
-		auto CD = ConnData[Cn.Value];
-		CD.Src = NodeIdMap[CD.Src];
-		CD.Dest = NodeIdMap[CD.Dest];
-		
-		auto CId = PackedConnections.Add(CD);
-		ConnNameAr.Add(ConnNames[Cn.Key]);
-//		NewConnectionMap.Add(CId, CId);
+		bSplit[Axis] = bCanSplit[Axis] && (bRefine || Size[Axis] > Settings.TargetCellSize);
 	}
 
-/*	NodeData = std::move(NewNodes);
-	ConnData = std::move(NewConnections);
-	NodeMap = std::move(NewNodeMap);
-	ConnectionMap = std::move(NewConnectionMap);
-	*/
-}
-
+	auto const Center = Box.GetCenter();
+	for(int32 Child = 0; Child < 8; ++Child)
+	{
+		FBox ChildBox = Box;
+		bool bDuplicate = false;
+		for(EAxisIndex Axis : FAxisUtils::AllAxes)
+		{
+			bool const bUpper = (Child & (1 << Axis)) != 0;
+			if(!bSplit[Axis])
+			{
+				// Only generate one child along axes that are not being split
+				bDuplicate |= bUpper;
+				continue;
+			}
 
-struct NodeRecord
-{
-	FVector Min, Max;
-};
+			if(bUpper)
+			{
+				ChildBox.Min[Axis] = Center[Axis];
+			}
+			else
+			{
+				ChildBox.Max[Axis] = Center[Axis];
+			}
+		}
 
-FArchive& operator<< (FArchive& Ar, NodeRecord& Rec)
-{
-	Ar << Rec.Min << Rec.Max;
-	return Ar;
+		if(!bDuplicate)
+		{
+			SubdivideAdaptive(ChildBox, Settings, Portals, World, OutCells);
+		}
+	}
 }
 
-struct ConnectionRecord
+void AInteriorGraphActor::ConnectAdjacentCells(
+	FInteriorGraphBuildState& State,
+	TArray< NodeIdType > const& Cells,
+	TArray< ConnectionIdType >& OutIds
+	)
 {
-	int32 Src, Dest;
-	FBox Portal;
-};
+	auto const AdjEpsilon = 1.e-4f;
 
-FArchive& operator<< (FArchive& Ar, ConnectionRecord& Rec)
-{
-	Ar << Rec.Src << Rec.Dest << Rec.Portal;
-	return Ar;
-}
+	for(EAxisIndex Axis : FAxisUtils::AllAxes)
+	{
+		// Sort by minimum along the axis, so for each cell we can find those starting where it ends
+		auto ByMin = Cells;
+		ByMin.Sort([&State, Axis](NodeIdType A, NodeIdType B)
+		{
+			return State.BuildND[A].Min[Axis] < State.BuildND[B].Min[Axis];
+		});
 
-void AInteriorGraphActor::Serialize(FArchive& Ar)
-{
-	Super::Serialize(Ar);
+		for(auto Id : Cells)
+		{
+			auto const FaceValue = State.BuildND[Id].Max[Axis];
+
+			// Lower bound on Min >= FaceValue - AdjEpsilon
+			int32 Lo = 0;
+			int32 Hi = ByMin.Num();
+			while(Lo < Hi)
+			{
+				auto Mid = (Lo + Hi) / 2;
+				if(State.BuildND[ByMin[Mid]].Min[Axis] < FaceValue - AdjEpsilon)
+				{
+					Lo = Mid + 1;
+				}
+				else
+				{
+					Hi = Mid;
+				}
+			}
+
+			for(int32 Idx = Lo; Idx < ByMin.Num(); ++Idx)
+			{
+				auto Adj = ByMin[Idx];
+				if(State.BuildND[Adj].Min[Axis] > FaceValue + AdjEpsilon)
+				{
+					break;
+				}
+
+				FAxisAlignedPlanarArea Shared;
+				if(TestForSharedSurface(State.BuildND[Id].Box(), State.BuildND[Adj].Box(), AdjEpsilon, &Shared))
+				{
+					ConnectCells(State, Id, Adj, Shared, OutIds);
+					ConnectCells(State, Adj, Id, Shared, OutIds);
+				}
+			}
+		}
+	}
+}
+
+void AInteriorGraphActor::MergeAdjacentCells(TArray< FBox >& Cells)
+{
+	auto const MergeEpsilon = 1.e-4f;
+
+	/*
+	One axis at a time, sort so that cells with identical cross sections perpendicular to the axis are
+	consecutive and ordered along it, then coalesce runs of cells which abut along the axis.
+	Doing this for X, then Y, then Z gives the same result as greedy meshing on a uniform grid.
+	*/
+	for(EAxisIndex Axis : FAxisUtils::AllAxes)
+	{
+		auto const A1 = FAxisUtils::OtherAxes[Axis][0];
+		auto const A2 = FAxisUtils::OtherAxes[Axis][1];
+
+		Cells.Sort([=](FBox const& L, FBox const& R)
+		{
+			if(L.Min[A1] != R.Min[A1]) return L.Min[A1] < R.Min[A1];
+			if(L.Min[A2] != R.Min[A2]) return L.Min[A2] < R.Min[A2];
+			if(L.Max[A1] != R.Max[A1]) return L.Max[A1] < R.Max[A1];
+			if(L.Max[A2] != R.Max[A2]) return L.Max[A2] < R.Max[A2];
+			return L.Min[Axis] < R.Min[Axis];
+		});
+
+		TArray< FBox > Merged;
+		Merged.Reserve(Cells.Num());
+		for(auto const& Cell : Cells)
+		{
+			if(Merged.Num() > 0)
+			{
+				auto& Last = Merged.Last();
+				if(FMath::IsNearlyEqual(Last.Min[A1], Cell.Min[A1], MergeEpsilon) &&
+					FMath::IsNearlyEqual(Last.Min[A2], Cell.Min[A2], MergeEpsilon) &&
+					FMath::IsNearlyEqual(Last.Max[A1], Cell.Max[A1], MergeEpsilon) &&
+					FMath::IsNearlyEqual(Last.Max[A2], Cell.Max[A2], MergeEpsilon) &&
+					FMath::IsNearlyEqual(Last.Max[Axis], Cell.Min[Axis], MergeEpsilon))
+				{
+					Last.Max[Axis] = Cell.Max[Axis];
+					continue;
+				}
+			}
+
+			Merged.Add(Cell);
+		}
+
+		Cells = std::move(Merged);
+	}
+}
+
+void AInteriorGraphActor::AddNodeCellBoxes(
+	FInteriorGraphBuildState& State,
+	NodeIdType OrigId,
+	FInteriorCellCandidates const& Candidates
+	)
+{
+	TArray< FBox > Surviving;
+	Surviving.Reserve(Candidates.Boxes.Num());
+	for(int32 Idx = 0; Idx < Candidates.Boxes.Num(); ++Idx)
+	{
+		if(!Candidates.Hidden[Idx])
+		{
+			Surviving.Add(Candidates.Boxes[Idx]);
+		}
+	}
+
+	if(State.Settings.bMergeCells)
+	{
+		MergeAdjacentCells(Surviving);
+	}
+
+	auto const IdBase = State.NextNodeId;
+	State.NextNodeId += Surviving.Num();
+
+	auto& Cells = State.OriginalNodeMap.Add(OrigId, TArray< NodeIdType >{});
+	Cells.Reserve(Surviving.Num());
+	for(int32 Idx = 0; Idx < Surviving.Num(); ++Idx)
+	{
+		Cells.Add(IdBase + Idx);
+		State.BuildND.Add(IdBase + Idx, FNodeData{ Surviving[Idx].Min, Surviving[Idx].Max });
+	}
+
+	for(auto Id : Cells)
+	{
+		State.CellOrigins.Add(Id, FInteriorCellOrigin{ OrigId, Id - IdBase, INDEX_NONE, INDEX_NONE });
+	}
+
+	auto& Internal = State.InternalConnectionMap.Add(OrigId, TArray< ConnectionIdType >{});
+	ConnectAdjacentCells(State, Cells, Internal);
+}
+
+void AInteriorGraphActor::BuildConnectionPortals(
+	FInteriorGraphBuildState& State,
+	ConnectionIdType OrigId,
+	FConnectionData const& CD
+	)
+{
+	auto& Generated = State.OriginalConnectionMap.Add(OrigId, TArray< ConnectionIdType >{});
+	State.OriginalConnectionEndpoints.Add(OrigId, TPair< NodeIdType, NodeIdType >{ CD.Src, CD.Dest });
+
+	auto PotentialN1 = State.OriginalNodeMap.Find(CD.Src);
+	auto PotentialN2 = State.OriginalNodeMap.Find(CD.Dest);
+	if(!PotentialN1 || !PotentialN2)
+	{
+		return;
+	}
+
+	auto const& Portal = CD.Portal;
+
+	// Find the cells on each side which touch the portal
+	TArray< TPair< NodeIdType, FBox > > Touching1;
+	for(auto N1 : *PotentialN1)
+	{
+		FAxisAlignedPlanarArea Surf1;
+		if(TestForSharedSurface(State.BuildND[N1].Box(), Portal, 1.e-4f, &Surf1))
+		{
+			Touching1.Add(TPair< NodeIdType, FBox >{ N1, FBox{ Surf1.Min, Surf1.Max } });
+		}
+	}
+
+	if(Touching1.Num() == 0)
+	{
+		return;
+	}
+
+	for(auto N2 : *PotentialN2)
+	{
+		FAxisAlignedPlanarArea Surf2;
+		if(TestForSharedSurface(State.BuildND[N2].Box(), Portal, 1.e-4f, &Surf2))
+		{
+			for(auto const& T1 : Touching1)
+			{
+				FAxisAlignedPlanarArea Shared;
+				if(TestForSharedSurface(
+					T1.Value,
+					FBox{ Surf2.Min, Surf2.Max },
+					1.e-4f,
+					&Shared))
+				{
+					ConnectCells(State, T1.Key, N2, Shared, Generated);
+					ConnectCells(State, N2, T1.Key, Shared, Generated);
+				}
+			}
+		}
+	}
+}
+
+void AInteriorGraphActor::RemoveNodeCells(FInteriorGraphBuildState& State, NodeIdType OrigId)
+{
+	auto Internal = State.InternalConnectionMap.Find(OrigId);
+	if(Internal)
+	{
+		for(auto CId : *Internal)
+		{
+			RemoveCellConnection(State, CId);
+		}
+		State.InternalConnectionMap.Remove(OrigId);
+	}
+
+	auto Cells = State.OriginalNodeMap.Find(OrigId);
+	if(Cells)
+	{
+		for(auto Id : *Cells)
+		{
+			State.BuildND.Remove(Id);
+			State.CellOrigins.Remove(Id);
+		}
+		State.OriginalNodeMap.Remove(OrigId);
+	}
+}
+
+void AInteriorGraphActor::RemoveConnectionPortals(FInteriorGraphBuildState& State, ConnectionIdType OrigId)
+{
+	auto Generated = State.OriginalConnectionMap.Find(OrigId);
+	if(Generated)
+	{
+		for(auto CId : *Generated)
+		{
+			RemoveCellConnection(State, CId);
+		}
+		State.OriginalConnectionMap.Remove(OrigId);
+	}
+
+	State.OriginalConnectionEndpoints.Remove(OrigId);
+}
+
+TSharedPtr< FInteriorGraphInstance > AInteriorGraphActor::BuildGraph(int32 Subdivision, int32 SubdivisionZ, bool bIncremental)
+{
+	return BuildGraph(FInteriorGraphBuildSettings::Uniform(Subdivision, SubdivisionZ), bIncremental);
+}
+
+TSharedPtr< FInteriorGraphInstance > AInteriorGraphActor::BuildGraph(FInteriorGraphBuildSettings const& Settings, bool bIncremental)
+{
+	FInteriorGraphBuildInput Input;
+	auto const Generation = MakeBuildInput(Settings, bIncremental, Input);
+
+	SelectBuild(Input, nullptr);
+	QueryCellCandidates(Input, GetWorld(), 0.0, nullptr);
+	auto Inst = ExecuteBuild(Input, nullptr);
+
+	AdoptBuildState(Input.State, Generation);
+	return Inst;
+}
+
+TSharedRef< FInteriorGraphBuildHandle > AInteriorGraphActor::BuildGraphAsync(FInteriorGraphBuildSettings const& Settings, bool bIncremental)
+{
+	TSharedRef< FInteriorGraphBuildHandle > Handle = MakeShareable(new FInteriorGraphBuildHandle);
+
+	auto Input = MakeShareable(new FInteriorGraphBuildInput);
+	auto const Generation = MakeBuildInput(Settings, bIncremental, *Input);
+	Handle->Start(this, Input, Generation);
+	return Handle;
+}
+
+/*
+Cached builds refer to nodes by their position in the cache key's node order, see GetBuildCacheKey.
+*/
+static void NodeIdsToKeyOrder(FInteriorGraphInstance& Inst, TArray< NodeIdType > const& NodeOrder)
+{
+	TMap< NodeIdType, NodeIdType > Positions;
+	Positions.Reserve(NodeOrder.Num());
+	for(int32 Idx = 0; Idx < NodeOrder.Num(); ++Idx)
+	{
+		Positions.Add(NodeOrder[Idx], Idx);
+	}
+
+	for(auto& Origin : Inst.CellOrigins)
+	{
+		Origin.OriginalNode = Positions.FindChecked(Origin.OriginalNode);
+	}
+}
+
+static bool KeyOrderToNodeIds(FInteriorGraphInstance& Inst, TArray< NodeIdType > const& NodeOrder)
+{
+	for(auto& Origin : Inst.CellOrigins)
+	{
+		if(!NodeOrder.IsValidIndex(Origin.OriginalNode))
+		{
+			return false;
+		}
+		Origin.OriginalNode = NodeOrder[Origin.OriginalNode];
+	}
+	return true;
+}
+
+TSharedPtr< FInteriorGraphInstance > AInteriorGraphActor::BuildGraphCached(FInteriorGraphBuildSettings const& Settings)
+{
+	auto Inst = FindCachedGraph(Settings);
+	if(Inst.IsValid())
+	{
+		// Retained build state and dirty flags are left untouched, so remain valid for a later incremental build
+		return Inst;
+	}
+
+	TArray< NodeIdType > NodeOrder;
+	auto const Key = GetBuildCacheKey(Settings, &NodeOrder);
+
+	Inst = BuildGraph(Settings);
+	NodeIdsToKeyOrder(*Inst, NodeOrder);
+	PutCachedInteriorGraph(Key, *Inst);
+	KeyOrderToNodeIds(*Inst, NodeOrder);
+	return Inst;
+}
+
+TSharedPtr< FInteriorGraphInstance > AInteriorGraphActor::FindCachedGraph(FInteriorGraphBuildSettings const& Settings) const
+{
+	TArray< NodeIdType > NodeOrder;
+	auto const Key = GetBuildCacheKey(Settings, &NodeOrder);
+
+	TSharedPtr< FInteriorGraphInstance > Inst = MakeShareable(new FInteriorGraphInstance);
+	if(!GetCachedInteriorGraph(Key, *Inst) || !KeyOrderToNodeIds(*Inst, NodeOrder))
+	{
+		return nullptr;
+	}
+
+#if INTERIOR_GRAPH_DEBUG_NAMES
+	Inst->OriginalNodeNames = NodeNames;
+	if(Settings.bEagerDebugNames)
+	{
+		Inst->GenerateNodeNames();
+	}
+#endif
+	return Inst;
+}
+
+bool AInteriorGraphActor::BuildAndStoreGraph(FInteriorGraphBuildSettings const& Settings)
+{
+	return StoreGraph(BuildGraphCached(Settings), Settings);
+}
+
+bool AInteriorGraphActor::StoreGraph(TSharedPtr< FInteriorGraphInstance > Inst, FInteriorGraphBuildSettings const& Settings)
+{
+	auto World = GetWorld();
+	if(!World || !Inst.IsValid())
+	{
+		return false;
+	}
+
+	FScopedTransaction Trans(TEXT("InteriorEditor"), FText::FromString(TEXT("Store Graph")), this);
+	Modify();
+
+	if(!GraphId.IsValid())
+	{
+		GraphId = FGuid::NewGuid();
+	}
+	StoredBuildSettings = Settings;
+
+	if(!StoredGraphActor || StoredGraphActor->IsPendingKill())
+	{
+		GetLevel()->Modify();
+
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.OverrideLevel = GetLevel();
+		StoredGraphActor = World->SpawnActor< AInteriorStoredGraphActor >(GetActorLocation(), FRotator::ZeroRotator, SpawnParams);
+		if(!StoredGraphActor)
+		{
+			return false;
+		}
+	}
+
+	StoredGraphActor->Modify();
+	StoredGraphActor->GraphId = GraphId;
+	StoredGraphActor->SetGraph(Inst);
+	return StoredGraphActor->HasGraph();
+}
+
+bool AInteriorGraphActor::RefreshStoredGraph(bool bAllowBuild)
+{
+	if(!StoredGraphActor || StoredGraphActor->HasGraph())
+	{
+		return HasStoredGraph();
+	}
+
+	auto Inst = bAllowBuild ? BuildGraphCached(StoredBuildSettings) : FindCachedGraph(StoredBuildSettings);
+	if(!Inst.IsValid())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s: the stored interior graph is out of date, and no matching build is cached."), *GetName());
+		return false;
+	}
+
+	StoredGraphActor->SetGraph(Inst);
+	return StoredGraphActor->HasGraph();
+}
+
+int32 AInteriorGraphActor::BuildAndStoreChunks(FInteriorGraphBuildSettings const& Settings, float ChunkSize)
+{
+	auto World = GetWorld();
+	if(!World || ChunkSize <= 0.f)
+	{
+		return 0;
+	}
+
+	auto Inst = BuildGraphCached(Settings);
+	if(!Inst.IsValid())
+	{
+		return 0;
+	}
+
+	FScopedTransaction Trans(TEXT("InteriorEditor"), FText::FromString(TEXT("Build Graph Chunks")), this);
+	Modify();
+	GetLevel()->Modify();
+
+	if(!GraphId.IsValid())
+	{
+		GraphId = FGuid::NewGuid();
+	}
+
+	for(TActorIterator< AInteriorGraphChunkActor > It(World); It; ++It)
+	{
+		if(It->GraphId == GraphId)
+		{
+			It->GetLevel()->Modify();
+			It->Modify();
+			World->EditorDestroyActor(*It, true);
+		}
+	}
+
+	TArray< FInteriorGraphChunkBuild > Chunks;
+	PartitionInteriorGraph(*Inst, ChunkSize, Chunks);
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.OverrideLevel = GetLevel();
+	for(auto const& Chunk : Chunks)
+	{
+		auto const Centre = FVector(Chunk.Coord.X + 0.5f, Chunk.Coord.Y + 0.5f, Chunk.Coord.Z + 0.5f) * ChunkSize;
+		auto ChunkActor = World->SpawnActor< AInteriorGraphChunkActor >(Centre, FRotator::ZeroRotator, SpawnParams);
+		if(ChunkActor)
+		{
+			ChunkActor->GraphId = GraphId;
+			ChunkActor->ChunkSize = ChunkSize;
+			ChunkActor->SetChunkData(Chunk.Coord, Chunk.Inst, Chunk.BorderPortals);
+		}
+	}
+
+	return Chunks.Num();
+}
+
+#if WITH_EDITOR
+TSharedPtr< FInteriorMeshConversionCache >& AInteriorGraphActor::GetMeshConversionCache()
+{
+	return MeshConversionCache;
+}
+#endif
+
+void AInteriorGraphActor::ClearStoredGraph()
+{
+	// Called on every edit, which the caller is recording, so the stored graph actor is recorded along with it
+	if(StoredGraphActor && StoredGraphActor->HasGraph())
+	{
+		StoredGraphActor->Modify();
+		StoredGraphActor->ClearGraph();
+	}
+}
+
+FInteriorGraphBuildSettings const* AInteriorGraphActor::GetStoredBuildSettings() const
+{
+	return StoredGraphActor ? &StoredBuildSettings : nullptr;
+}
+
+bool AInteriorGraphActor::HasStoredGraph() const
+{
+	return StoredGraphActor && StoredGraphActor->HasGraph();
+}
+
+FInteriorGraphBlob const* AInteriorGraphActor::GetStoredGraphBlob() const
+{
+	return StoredGraphActor ? StoredGraphActor->GetBlob() : nullptr;
+}
+
+TSharedPtr< FInteriorGraphInstance > AInteriorGraphActor::GetStoredGraph()
+{
+	return StoredGraphActor ? StoredGraphActor->GetInstance() : nullptr;
+}
+
+FString AInteriorGraphActor::GetBuildCacheKey(FInteriorGraphBuildSettings const& Settings, TArray< NodeIdType >* OutNodeOrder) const
+{
+	TArray< uint8 > KeyData;
+	FMemoryWriter Ar(KeyData, true);
+
+	auto Mode = (int32)Settings.Mode;
+	auto Subdivision = Settings.Subdivision;
+	auto SubdivisionZ = Settings.SubdivisionZ;
+	auto TargetCellSize = Settings.TargetCellSize;
+	auto MinCellSize = Settings.MinCellSize;
+	auto PortalRefineDistance = Settings.PortalRefineDistance;
+	auto bRefineNearGeometry = Settings.bRefineNearGeometry;
+	auto bMergeCells = Settings.bMergeCells;
+	Ar << Mode << Subdivision << SubdivisionZ;
+	Ar << TargetCellSize << MinCellSize << PortalRefineDistance << bRefineNearGeometry << bMergeCells;
+
+	// Nodes are ordered by geometry, falling back on ids only for coincident nodes, which are interchangeable
+	TArray< NodeIdType > NodeIds = GetAllNodes();
+	NodeIds.Sort([this](NodeIdType A, NodeIdType B)
+	{
+		auto const& NA = GetNodeData(A);
+		auto const& NB = GetNodeData(B);
+		float const KeysA[] = { NA.Min.X, NA.Min.Y, NA.Min.Z, NA.Max.X, NA.Max.Y, NA.Max.Z };
+		float const KeysB[] = { NB.Min.X, NB.Min.Y, NB.Min.Z, NB.Max.X, NB.Max.Y, NB.Max.Z };
+		for(int32 Idx = 0; Idx < ARRAY_COUNT(KeysA); ++Idx)
+		{
+			if(KeysA[Idx] != KeysB[Idx])
+			{
+				return KeysA[Idx] < KeysB[Idx];
+			}
+		}
+		return A < B;
+	});
+
+	TMap< NodeIdType, int32 > Positions;
+	Positions.Reserve(NodeIds.Num());
+	auto Bounds = FBox(0);
+	for(auto NId : NodeIds)
+	{
+		auto const& ND = GetNodeData(NId);
+		auto Min = ND.Min;
+		auto Max = ND.Max;
+		Ar << Min << Max;
+
+		Positions.Add(NId, Positions.Num());
+		Bounds += ND.Box();
+	}
+
+	// Connections are described by node position, then sorted, since map iteration order is arbitrary
+	TArray< FString > ConnEntries;
+	ConnEntries.Reserve(NumConnections());
+	for(auto CId : GetAllConnections())
+	{
+		auto const& CD = GetConnectionData(CId);
+		TArray< uint8 > Entry;
+		FMemoryWriter EntryAr(Entry, true);
+		auto Src = Positions.FindChecked(CD.Src);
+		auto Dest = Positions.FindChecked(CD.Dest);
+		auto Portal = CD.Portal;
+		EntryAr << Src << Dest << Portal;
+		ConnEntries.Add(BytesToHex(Entry.GetData(), Entry.Num()));
+	}
+	ConnEntries.Sort();
+	Ar << ConnEntries;
+
+	SerializeWorldCollisionForCacheKey(GetWorld(), Bounds, this, Ar);
+
+	if(OutNodeOrder)
+	{
+		*OutNodeOrder = std::move(NodeIds);
+	}
+	return MakeInteriorGraphCacheKey(KeyData);
+}
+
+int32 AInteriorGraphActor::MakeBuildInput(FInteriorGraphBuildSettings const& Settings, bool bIncremental, FInteriorGraphBuildInput& Input)
+{
+	Input.Settings = Settings;
+
+	Input.Nodes.Empty(NumNodes());
+	ForEachNode([this, &Input](NodeIdType Id, int32 Idx)
+	{
+		Input.Nodes.Add(Id, NodeData[Idx]);
+	});
+	Input.Connections.Empty(NumConnections());
+	ForEachConnection([this, &Input](ConnectionIdType Id, int32 Idx)
+	{
+		Input.Connections.Add(Id, ConnData[Idx]);
+	});
+#if INTERIOR_GRAPH_DEBUG_NAMES
+	Input.NodeNames = NodeNames;
+#endif
+
+	/*
+	The build takes ownership of the retained state until it completes. Any build or invalidation started in the
+	meantime bumps the generation, so that the state from this build is then discarded rather than adopted.
+	*/
+	if(bIncremental && BuildState.IsValid() && BuildState->Settings == Settings)
+	{
+		Input.State = BuildState;
+		Input.DirtyNodes = std::move(DirtyNodes);
+		Input.DirtyConnections = std::move(DirtyConnections);
+	}
+
+	BuildState.Reset();
+	DirtyNodes.Empty();
+	DirtyConnections.Empty();
+	return ++BuildGeneration;
+}
+
+void AInteriorGraphActor::AdoptBuildState(
+	TSharedPtr< FInteriorGraphBuildState > State,
+	int32 Generation,
+	TSet< NodeIdType > const* UnbuiltNodes,
+	TSet< ConnectionIdType > const* UnbuiltConnections
+	)
+{
+	if(Generation != BuildGeneration)
+	{
+		return;
+	}
+
+	BuildState = State;
+	if(UnbuiltNodes)
+	{
+		DirtyNodes.Append(*UnbuiltNodes);
+	}
+	if(UnbuiltConnections)
+	{
+		DirtyConnections.Append(*UnbuiltConnections);
+	}
+}
+
+void AInteriorGraphActor::SelectBuild(FInteriorGraphBuildInput& Input, FInteriorGraphBuildProgress* Progress)
+{
+	auto const& Settings = Input.Settings;
+	bool const bAdaptive = Settings.Mode == EInteriorSubdivisionMode::Adaptive;
+
+	auto& NodesToBuild = Input.NodesToBuild;
+	auto& ConnectionsToBuild = Input.ConnectionsToBuild;
+	if(Input.State.IsValid())
+	{
+		NodesToBuild = Input.DirtyNodes;
+		ConnectionsToBuild = Input.DirtyConnections;
+
+		if(bAdaptive)
+		{
+			// Adaptive cell layout depends on portals, so nodes either side of a modified portal must be rebuilt
+			for(auto CId : Input.DirtyConnections)
+			{
+				auto Prev = Input.State->OriginalConnectionEndpoints.Find(CId);
+				if(Prev)
+				{
+					NodesToBuild.Add(Prev->Key);
+					NodesToBuild.Add(Prev->Value);
+				}
+
+				auto CD = Input.Connections.Find(CId);
+				if(CD)
+				{
+					NodesToBuild.Add(CD->Src);
+					NodesToBuild.Add(CD->Dest);
+				}
+			}
+		}
+
+		// Portal cells must be regenerated whenever the cells on either side of the portal have changed
+		for(auto const& Cn : Input.Connections)
+		{
+			if(NodesToBuild.Contains(Cn.Value.Src) || NodesToBuild.Contains(Cn.Value.Dest))
+			{
+				ConnectionsToBuild.Add(Cn.Key);
+			}
+		}
+	}
+	else
+	{
+		Input.State = MakeShareable(new FInteriorGraphBuildState(Settings));
+		for(auto const& N : Input.Nodes)
+		{
+			NodesToBuild.Add(N.Key);
+		}
+		for(auto const& Cn : Input.Connections)
+		{
+			ConnectionsToBuild.Add(Cn.Key);
+		}
+	}
+
+	if(bAdaptive)
+	{
+		for(auto const& Cn : Input.Connections)
+		{
+			Input.NodePortals.FindOrAdd(Cn.Value.Src).Add(Cn.Value.Portal);
+			Input.NodePortals.FindOrAdd(Cn.Value.Dest).Add(Cn.Value.Portal);
+		}
+	}
+
+	for(auto NId : NodesToBuild)
+	{
+		if(Input.Nodes.Contains(NId))
+		{
+			Input.PendingQueries.Add(NId);
+		}
+	}
+
+	if(Progress)
+	{
+		// One step per node query, node and connection, plus one for packing
+		Progress->Total.Set(Input.PendingQueries.Num() + NodesToBuild.Num() + ConnectionsToBuild.Num() + 1);
+	}
+}
+
+bool AInteriorGraphActor::QueryCellCandidates(
+	FInteriorGraphBuildInput& Input,
+	UWorld* World,
+	double TimeLimit,
+	FInteriorGraphBuildProgress* Progress
+	)
+{
+	check(IsInGameThread());
+
+	auto const EndTime = FPlatformTime::Seconds() + TimeLimit;
+	TArray< FBox > const NoPortals;
+	while(Input.PendingQueries.Num() > 0)
+	{
+		if(Progress && Progress->IsCancelled())
+		{
+			return false;
+		}
+
+		auto const NId = Input.PendingQueries.Pop();
+		auto Portals = Input.NodePortals.Find(NId);
+		auto& Candidates = Input.CellCandidates.Add(NId, FInteriorCellCandidates{});
+		FindCellCandidates(Input.Settings, Input.Nodes[NId], Portals ? *Portals : NoPortals, World, Candidates);
+
+		if(Progress)
+		{
+			Progress->Completed.Increment();
+		}
+
+		if(TimeLimit > 0.0 && FPlatformTime::Seconds() >= EndTime)
+		{
+			break;
+		}
+	}
+
+	return Input.PendingQueries.Num() == 0;
+}
+
+TSharedPtr< FInteriorGraphInstance > AInteriorGraphActor::ExecuteBuild(FInteriorGraphBuildInput& Input, FInteriorGraphBuildProgress* Progress)
+{
+	check(Input.State.IsValid() && Input.PendingQueries.Num() == 0);
+
+	auto const& NodesToBuild = Input.NodesToBuild;
+	auto const& ConnectionsToBuild = Input.ConnectionsToBuild;
+	auto& State = *Input.State;
+
+	// Remove stale cells and connections first, since portal connections reference the cells of both nodes
+	for(auto CId : ConnectionsToBuild)
+	{
+		RemoveConnectionPortals(State, CId);
+	}
+	for(auto NId : NodesToBuild)
+	{
+		RemoveNodeCells(State, NId);
+	}
+
+	/*
+	On cancellation, everything selected for building is handed back as dirty. Removing and regenerating the cells
+	of a node or connection which had already been done is harmless, so the state remains usable.
+	*/
+	auto Cancel = [&Input]() -> TSharedPtr< FInteriorGraphInstance >
+	{
+		Input.DirtyNodes = Input.NodesToBuild;
+		Input.DirtyConnections = Input.ConnectionsToBuild;
+		return nullptr;
+	};
+
+	// Then regenerate for whatever still exists
+	for(auto NId : NodesToBuild)
+	{
+		if(Progress && Progress->IsCancelled())
+		{
+			return Cancel();
+		}
+
+		auto Candidates = Input.CellCandidates.Find(NId);
+		if(Candidates)
+		{
+			BuildNodeCells(State, NId, *Candidates);
+		}
+
+		if(Progress)
+		{
+			Progress->Completed.Increment();
+		}
+	}
+	for(auto CId : ConnectionsToBuild)
+	{
+		if(Progress && Progress->IsCancelled())
+		{
+			return Cancel();
+		}
+
+		auto CD = Input.Connections.Find(CId);
+		if(CD)
+		{
+			BuildConnectionPortals(State, CId, *CD);
+		}
+
+		if(Progress)
+		{
+			Progress->Completed.Increment();
+		}
+	}
+
+	TSharedPtr< FInteriorGraphInstance > Inst = MakeShareable(new FInteriorGraphInstance);
+	PackNodeAndConnectionData(Inst, State.BuildND, State.BuildCD, State.CellOrigins);
 
-	// TODO: Ideally, we should serialize a flag specifying whether or not the graph has been saved with or
-	// without node/connection names.
+#if INTERIOR_GRAPH_DEBUG_NAMES
+	Inst->OriginalNodeNames = Input.NodeNames;
+	if(Input.Settings.bEagerDebugNames)
+	{
+		Inst->GenerateNodeNames();
+	}
+#endif
 
-	TArray< NodeRecord > NodeRecords;
-	TArray< ConnectionRecord > ConnectionRecords;
-	TArray< FString > NodeNameArray;
-	TArray< FString > ConnNameArray;
-	if(Ar.IsSaving())
+	if(Progress)
+	{
+		Progress->Completed.Increment();
+	}
+
+	return Inst;
+}
+
+bool AInteriorGraphActor::RemoveNode(NodeIdType Id)
+{
+	if(!HasNode(Id))
+	{
+		return false;
+	}
+
+	// Removal leaves a gap, so ids can no longer be identity mapped
+	MaterializeIdMaps();
+
+	// Remove all connection into and out of this node
+	auto Conns = GetAllNodeConnections(Id);
+	for(auto CId : Conns)
+	{
+		RemoveConnection(CId);
+	}
+
+	// Finally, remove the node itself
+	// Note we are currently just removing the map key without condensing the array and remapping
+	NodeData[NodeMap[Id]] = FNodeData{};
+#if INTERIOR_GRAPH_DEBUG_NAMES
+	NodeNames.Remove(Id);
+#endif
+	NodeMap.Remove(Id);
+	MarkNodeDirty(Id);
+
+	return true;
+}
+
+bool AInteriorGraphActor::RemoveConnection(ConnectionIdType Id)
+{
+	if(!HasConnection(Id))
+	{
+		return false;
+	}
+
+	MaterializeIdMaps();
+
+	auto& Cn = ConnData[ConnectionMap[Id]];
+	
+	// TODO: Decide what to do with in/out and bidirectional
+	GetNodeDataRef(Cn.Src).Outgoing.Remove(Id);
+	GetNodeDataRef(Cn.Dest).Outgoing.Remove(Id);
+
+	Cn = FConnectionData{};
+	ConnectionMap.Remove(Id);
+	MarkConnectionDirty(Id);
+	return true;
+}
+
+ConnectionIdType AInteriorGraphActor::FindFirstConnection(FConnectionKey const& Key) const
+{
+	auto ElemPtr = ConnData.FindByPredicate(TArrayPred{ Key });
+	if(ElemPtr)
+	{
+		auto Idx = ElemPtr - ConnData.GetData();
+		if(bIdentityIds)
+		{
+			return (ConnectionIdType)Idx;
+		}
+
+		auto KeyPtr = ConnectionMap.FindKey(Idx);
+		check(KeyPtr);
+		return *KeyPtr;
+	}
+
+	return NullConnection;
+}
+
+ConnectionIdType AInteriorGraphActor::CreateConnection(
+	NodeIdType N1,
+	NodeIdType N2,
+	FAxisAlignedPlanarArea const& area)
+{
+	FConnectionData Conn;
+	Conn.Src = N1;
+	Conn.Dest = N2;
+	Conn.Portal = FBox{ area.Min, area.Max };
+
+	auto Idx = ConnData.Add(Conn);
+	auto Id = NextConnectionId++;
+	if(bIdentityIds)
+	{
+		check(Idx == Id);
+	}
+	else
 	{
-		// Ensure ids are reduced to 0-based with no gaps. This way we don't need to serialize them, since
-		// they are just equivalent to the position within the serialized array.
-		TArray< FNodeData > PackedNodes;
-		TArray< FConnectionData > PackedConnections;
-		GetPackedData(PackedNodes, PackedConnections, NodeNameArray, ConnNameArray);
+		ConnectionMap.Add(Id, Idx);
+	}
+	MarkConnectionDirty(Id);
+
+#if WITH_EDITOR
+	FString Nm = TEXT("Connection ");
+	Nm.AppendInt(Id);
+	ConnNames.Add(Id, Nm);
+#endif
+
+	return Id;
+}
+
 
-		for(auto const& Nd : PackedNodes)
+static_assert(sizeof(FPackedNodeRecord) == 24, "Record layout changed, bump FInteriorGraphCustomVersion");
+static_assert(sizeof(FPackedConnectionRecord) == 32, "Record layout changed, bump FInteriorGraphCustomVersion");
+
+
+/*
+Serializes an array of POD records as a count followed by a single block of memory.
+Falls back to per-element serialization if the archive is byte swapping.
+*/
+template < typename T >
+static void BulkSerializeRecords(FArchive& Ar, TArray< T >& Records)
+{
+	int32 Num = Records.Num();
+	Ar << Num;
+
+	if(Ar.IsLoading())
+	{
+		auto const Remaining = Ar.TotalSize() - Ar.Tell();
+		if(Num < 0 || (Ar.TotalSize() >= 0 && (int64)Num * (int64)sizeof(T) > Remaining))
 		{
-			NodeRecord NR;
-			NR.Min = Nd.Min;
-			NR.Max = Nd.Max;
-			NodeRecords.Add(NR);
+			Ar.ArIsError = true;
+			Records.Empty();
+			return;
 		}
 
-		for(auto const& Cn : PackedConnections)
+		Records.Empty(Num);
+		Records.AddUninitialized(Num);
+	}
+
+	if(Ar.IsByteSwapping())
+	{
+		for(auto& Rec : Records)
 		{
-			ConnectionRecord CR;
-			CR.Src = Cn.Src;
-			CR.Dest = Cn.Dest;
-			CR.Portal = Cn.Portal;
-			ConnectionRecords.Add(CR);
+			Ar << Rec;
 		}
 	}
+	else
+	{
+		Ar.Serialize(Records.GetData(), Num * sizeof(T));
+	}
+}
 
-	Ar << NodeRecords;
-	Ar << ConnectionRecords;
-	
-//	if(Ar.IsSaving())
+
+template < typename T >
+static void ApplyRecordOrder(TArray< T >& Items, TArray< int32 > const& Order)
+{
+	if(Items.Num() != Order.Num())
 	{
-		Ar << NodeNameArray;
-		Ar << ConnNameArray;
+		return;
 	}
 
-	if(Ar.IsLoading())
+	TArray< T > Reordered;
+	Reordered.Empty(Order.Num());
+	for(auto Idx : Order)
+	{
+		Reordered.Add(MoveTemp(Items[Idx]));
+	}
+	Items = MoveTemp(Reordered);
+}
+
+enum class EInteriorRecordEncoding: uint8 {
+	Raw,
+	Quantized,
+};
+
+
+/*
+Pre-BulkRecords format, only ever loaded.
+*/
+struct NodeRecord
+{
+	FVector Min, Max;
+};
+
+FArchive& operator<< (FArchive& Ar, NodeRecord& Rec)
+{
+	Ar << Rec.Min << Rec.Max;
+	return Ar;
+}
+
+struct ConnectionRecord
+{
+	int32 Src, Dest;
+	FBox Portal;
+};
+
+FArchive& operator<< (FArchive& Ar, ConnectionRecord& Rec)
+{
+	Ar << Rec.Src << Rec.Dest << Rec.Portal;
+	return Ar;
+}
+
+static void LoadLegacyRecords(
+	FArchive& Ar,
+	TArray< FPackedNodeRecord >& NodeRecords,
+	TArray< FPackedConnectionRecord >& ConnectionRecords
+	)
+{
+	TArray< NodeRecord > LegacyNodes;
+	TArray< ConnectionRecord > LegacyConnections;
+	Ar << LegacyNodes;
+	Ar << LegacyConnections;
+
+	NodeRecords.Empty(LegacyNodes.Num());
+	for(auto const& NR : LegacyNodes)
+	{
+		NodeRecords.Add(FPackedNodeRecord{ NR.Min, NR.Max });
+	}
+
+	ConnectionRecords.Empty(LegacyConnections.Num());
+	for(auto const& CR : LegacyConnections)
+	{
+		ConnectionRecords.Add(FPackedConnectionRecord{ CR.Src, CR.Dest, CR.Portal.Min, CR.Portal.Max });
+	}
+}
+
+
+void AInteriorGraphActor::GetPackedRecords(
+	TArray< FPackedNodeRecord >& NodeRecords,
+	TArray< FPackedConnectionRecord >& ConnectionRecords,
+	TArray< FString >* NodeNameAr,
+	TArray< FString >* ConnNameAr
+	) const
+{
+	// Ensure ids are reduced to 0-based with no gaps. If ids are identity mapped, they already are.
+	TMap< NodeIdType, int32 > NodeIdMap;
+	if(!bIdentityIds)
+	{
+		NodeIdMap.Empty(NodeMap.Num());
+	}
+
+	NodeRecords.Empty(NumNodes());
+
+	ForEachNode([&](NodeIdType Id, int32 Idx)
+	{
+		auto const& ND = NodeData[Idx];
+		if(!bIdentityIds)
+		{
+			NodeIdMap.Add(Id, NodeRecords.Num());
+		}
+		NodeRecords.Add(FPackedNodeRecord{ ND.Min, ND.Max });
+	});
+
+	// Connections are written in map order, which is also the order in which they'll be re-added to each node's
+	// outgoing list on load
+	ConnectionRecords.Empty(NumConnections());
+	ForEachConnection([&](ConnectionIdType Id, int32 Idx)
+	{
+		auto const& CD = ConnData[Idx];
+		ConnectionRecords.Add(FPackedConnectionRecord{
+			bIdentityIds ? CD.Src : NodeIdMap[CD.Src],
+			bIdentityIds ? CD.Dest : NodeIdMap[CD.Dest],
+			CD.Portal.Min,
+			CD.Portal.Max
+		});
+	});
+
+#if INTERIOR_GRAPH_DEBUG_NAMES
+	if(NodeNameAr)
 	{
-		NodeData.Empty(NodeRecords.Num());
-		NodeMap.Empty(NodeRecords.Num());
-		for(auto const& NR : NodeRecords)
+		NodeNameAr->Empty(NumNodes());
+		ForEachNode([&](NodeIdType Id, int32 Idx)
 		{
-			FNodeData Nd;
-			Nd.Min = NR.Min;
-			Nd.Max = NR.Max;
-			auto Idx = NodeData.Add(Nd);
+			NodeNameAr->Add(NodeNames.FindRef(Id));
+		});
+	}
 
-			NodeMap.Add(Idx, Idx);
+	if(ConnNameAr)
+	{
+		ConnNameAr->Empty(NumConnections());
+		ForEachConnection([&](ConnectionIdType Id, int32 Idx)
+		{
+			ConnNameAr->Add(ConnNames.FindRef(Id));
+		});
+	}
+#endif
+}
 
-			//
-//			NodeNames.Add(Idx, FString{});
-			//
+void AInteriorGraphActor::LoadPackedRecords(
+	TArray< FPackedNodeRecord > const& NodeRecords,
+	TArray< FPackedConnectionRecord > const& ConnectionRecords,
+	TArray< FString > const* NodeNameAr,
+	TArray< FString > const* ConnNameAr
+	)
+{
+	// Ids are packed, so start out identity mapped with no need for the id maps
+	bIdentityIds = true;
+	NodeMap.Empty();
+	ConnectionMap.Empty();
+
+	// Counting pass, so that each outgoing list is allocated once
+	TArray< int32 > OutgoingCounts;
+	OutgoingCounts.AddZeroed(NodeRecords.Num());
+	for(auto const& CR : ConnectionRecords)
+	{
+		if(OutgoingCounts.IsValidIndex(CR.Src))
+		{
+			++OutgoingCounts[CR.Src];
 		}
+	}
+
+	NodeData.Empty(NodeRecords.Num());
+	NodeData.SetNum(NodeRecords.Num());
+	for(int32 Idx = 0; Idx < NodeRecords.Num(); ++Idx)
+	{
+		auto& Nd = NodeData[Idx];
+		Nd.Min = NodeRecords[Idx].Min;
+		Nd.Max = NodeRecords[Idx].Max;
+		Nd.Outgoing.Empty(OutgoingCounts[Idx]);
+	}
+
+	ConnData.Empty(ConnectionRecords.Num());
+	for(auto const& CR : ConnectionRecords)
+	{
+		FConnectionData Cn;
+		Cn.Src = CR.Src;
+		Cn.Dest = CR.Dest;
+		Cn.Portal = FBox(CR.PortalMin, CR.PortalMax);
+		auto Idx = ConnData.Add(Cn);
+
+		NodeData[Cn.Src].Outgoing.Add(Idx);
+	}
 
-		NodeNames.Empty(NodeRecords.Num());
-		for(auto const& NNm : NodeNameArray)
+#if INTERIOR_GRAPH_DEBUG_NAMES
+	NodeNames.Empty(NodeNameAr ? NodeNameAr->Num() : 0);
+	if(NodeNameAr)
+	{
+		for(auto const& NNm : *NodeNameAr)
 		{
 			NodeNames.Add(NodeNames.Num(), NNm);
 		}
+	}
 
-		ConnData.Empty(ConnectionRecords.Num());
-		ConnectionMap.Empty(ConnectionRecords.Num());
-		for(auto const& CR : ConnectionRecords)
+	ConnNames.Empty(ConnNameAr ? ConnNameAr->Num() : 0);
+	if(ConnNameAr)
+	{
+		for(auto const& CNm : *ConnNameAr)
 		{
-			FConnectionData Cn;
-			Cn.Src = CR.Src;
-			Cn.Dest = CR.Dest;
-			Cn.Portal = CR.Portal;
-			auto Idx = ConnData.Add(Cn);
+			ConnNames.Add(ConnNames.Num(), CNm);
+		}
+	}
+#endif
+
+	NextNodeId = NodeData.Num();
+	NextConnectionId = ConnData.Num();
+
+	// Ids have been reassigned, so nothing from a previous build can be reused
+	InvalidateBuildState();
+}
+
+void AInteriorGraphActor::Serialize(FArchive& Ar)
+{
+	Super::Serialize(Ar);
+
+	Ar.UsingCustomVersion(FInteriorGraphCustomVersion::GUID);
+
+	auto const Version = Ar.IsLoading() ?
+		Ar.CustomVer(FInteriorGraphCustomVersion::GUID) :
+		(int32)FInteriorGraphCustomVersion::LatestVersion;
 
-			ConnectionMap.Add(Idx, Idx);
+	TArray< FPackedNodeRecord > NodeRecords;
+	TArray< FPackedConnectionRecord > ConnectionRecords;
+	TArray< FString > NodeNameArray;
+	TArray< FString > ConnNameArray;
 
-			NodeData[Cn.Src].Outgoing.Add(Idx);
+	// Names are debug only, so are stripped when cooking
+	bool bHasNames = INTERIOR_GRAPH_DEBUG_NAMES && !Ar.IsCooking();
+
+	if(Version < FInteriorGraphCustomVersion::BulkRecords)
+	{
+		LoadLegacyRecords(Ar, NodeRecords, ConnectionRecords);
+	}
+	else
+	{
+		// Undo snapshots favour speed over size
+		auto Encoding = bCompactSerialization && !Ar.IsTransacting() ?
+			EInteriorRecordEncoding::Quantized :
+			EInteriorRecordEncoding::Raw;
+		TArray< uint8 > EncodedRecords;
 
-			//
-//			ConnNames.Add(Idx, FString{});
-			//
+		if(Ar.IsSaving())
+		{
+			GetPackedRecords(
+				NodeRecords,
+				ConnectionRecords,
+				bHasNames ? &NodeNameArray : nullptr,
+				bHasNames ? &ConnNameArray : nullptr
+				);
+
+			if(Encoding == EInteriorRecordEncoding::Quantized)
+			{
+				// Records are reordered by the encoding, so the names must follow
+				TArray< int32 > NodeOrder, ConnectionOrder;
+				EncodeQuantizedRecords(NodeRecords, ConnectionRecords, EncodedRecords, NodeOrder, ConnectionOrder);
+				ApplyRecordOrder(NodeNameArray, NodeOrder);
+				ApplyRecordOrder(ConnNameArray, ConnectionOrder);
+			}
 		}
 
-		ConnNames.Empty(ConnectionRecords.Num());
-		for(auto const& CNm : ConnNameArray)
+		if(Version >= FInteriorGraphCustomVersion::QuantizedRecords)
 		{
-			ConnNames.Add(ConnNames.Num(), CNm);
+			auto EncodingByte = (uint8)Encoding;
+			Ar << EncodingByte;
+			Encoding = (EInteriorRecordEncoding)EncodingByte;
+		}
+		else
+		{
+			Encoding = EInteriorRecordEncoding::Raw;
+		}
+
+		switch(Encoding)
+		{
+			case EInteriorRecordEncoding::Raw:
+			BulkSerializeRecords(Ar, NodeRecords);
+			BulkSerializeRecords(Ar, ConnectionRecords);
+			break;
+
+			case EInteriorRecordEncoding::Quantized:
+			BulkSerializeRecords(Ar, EncodedRecords);
+			if(Ar.IsLoading() && !DecodeQuantizedRecords(EncodedRecords, NodeRecords, ConnectionRecords))
+			{
+				Ar.ArIsError = true;
+			}
+			break;
+
+			default:
+			Ar.ArIsError = true;
+			break;
 		}
+	}
+
+	if(Version >= FInteriorGraphCustomVersion::OptionalNames)
+	{
+		Ar << bHasNames;
+	}
+	else
+	{
+		bHasNames = true;
+	}
+
+	if(bHasNames)
+	{
+		// If names are compiled out, these are read only to skip past them
+		Ar << NodeNameArray;
+		Ar << ConnNameArray;
+	}
 
-		NextNodeId = NodeMap.Num();
-		NextConnectionId = ConnectionMap.Num();
+	if(Ar.IsLoading() && !Ar.IsError())
+	{
+		LoadPackedRecords(
+			NodeRecords,
+			ConnectionRecords,
+			bHasNames ? &NodeNameArray : nullptr,
+			bHasNames ? &ConnNameArray : nullptr
+			);
+	}
+
+	if(Version >= FInteriorGraphCustomVersion::StoredGraph && Version < FInteriorGraphCustomVersion::StoredGraphActor)
+	{
+		// Stored builds used to be held by the graph actor itself. They can't be moved to a stored graph actor during
+		// load, so are skipped, and need storing again.
+		TArray< uint8 > LegacyStoredGraph;
+		BulkSerializeRecords(Ar, LegacyStoredGraph);
+	}
+
+	if(Version >= FInteriorGraphCustomVersion::StoredBuildSettings)
+	{
+		Ar << StoredBuildSettings;
 	}
 }
 
 void AInteriorGraphActor::PreInitializeComponents()
 {
 	Super::PreInitializeComponents();
+
+	// Play in editor runs on a copy of the level, so an out of date stored build is only replaced within the copy
+	auto World = GetWorld();
+	if(World && World->WorldType == EWorldType::PIE)
+	{
+		RefreshStoredGraph(true);
+	}
+}
+
+void AInteriorGraphActor::PreSave()
+{
+	Super::PreSave();
+
+	// Worlds aren't initialized when cooking, so can't be traced to build, but a cached build can still be stored
+	if(IsRunningCommandlet())
+	{
+		RefreshStoredGraph(false);
+	}
 }
 
 void AInteriorGraphActor::AddReferencedObjects(UObject* InThis, FReferenceCollector& Collector)
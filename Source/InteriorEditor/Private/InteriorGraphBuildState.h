@@ -0,0 +1,116 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "InteriorGraphTypes.h"
+#include "InteriorGraphInstance.h"
+#include "InteriorGraphBuildSettings.h"
+#include "ThreadSafeCounter.h"
+
+
+/*
+Intermediate (pre-packing) result of the most recent BuildGraph call on a graph actor.
+This is kept around so that a subsequent build only needs to regenerate the cells belonging to authored
+nodes, and the portals belonging to authored connections, which have changed since.
+Build ids are never reused, so cells which are not regenerated keep their ids between builds.
+*/
+struct FInteriorGraphBuildState
+{
+	FInteriorGraphBuildSettings Settings;
+
+	// Surviving (non-hidden) cells, and the connections between them, keyed by build id
+	TMap< NodeIdType, FNodeData > BuildND;
+	TMap< ConnectionIdType, FConnectionData > BuildCD;
+
+	// Map from original node Id to the build ids of its surviving cells
+	TMap< NodeIdType, TArray< NodeIdType > > OriginalNodeMap;
+	// Map from original node Id to the build ids of the connections between its own cells
+	TMap< NodeIdType, TArray< ConnectionIdType > > InternalConnectionMap;
+	// Map from original connection Id to the build ids of the cell connections generated through its portal
+	TMap< ConnectionIdType, TArray< ConnectionIdType > > OriginalConnectionMap;
+	// Map from original connection Id to the original nodes it connected when it was built
+	TMap< ConnectionIdType, TPair< NodeIdType, NodeIdType > > OriginalConnectionEndpoints;
+
+	NodeIdType NextNodeId;
+	ConnectionIdType NextConnectionId;
+
+	// Origin of each surviving cell, keyed by build id
+	TMap< NodeIdType, FInteriorCellOrigin > CellOrigins;
+
+	FInteriorGraphBuildState(FInteriorGraphBuildSettings const& InSettings):
+		Settings(InSettings),
+		NextNodeId(0),
+		NextConnectionId(0)
+	{}
+};
+
+/*
+The cells a node is divided into before hidden ones are removed, and which of them are hidden. Finding these queries
+the world, so is done on the game thread ahead of the rest of the build.
+*/
+struct FInteriorCellCandidates
+{
+	TArray< FBox > Boxes;
+	TBitArray<> Hidden;
+};
+
+/*
+Snapshot of everything a build needs from the graph actor and the world, so that the build itself never touches
+either and can run off the game thread.
+*/
+struct FInteriorGraphBuildInput
+{
+	FInteriorGraphBuildSettings Settings;
+
+	// Original nodes and connections, keyed by original Id
+	TMap< NodeIdType, FNodeData > Nodes;
+	TMap< ConnectionIdType, FConnectionData > Connections;
+#if INTERIOR_GRAPH_DEBUG_NAMES
+	TMap< NodeIdType, FString > NodeNames;
+#endif
+
+	/*
+	State from a previous build to be updated incrementally, along with the original nodes/connections modified
+	since. If null, a full build is done. Either way, holds the resulting state once the build has completed.
+	*/
+	TSharedPtr< FInteriorGraphBuildState > State;
+	TSet< NodeIdType > DirtyNodes;
+	TSet< ConnectionIdType > DirtyConnections;
+
+	/*
+	Filled in by AInteriorGraphActor::SelectBuild. The original nodes and connections to regenerate, and the portals
+	of each node, for adaptive builds.
+	*/
+	TSet< NodeIdType > NodesToBuild;
+	TSet< ConnectionIdType > ConnectionsToBuild;
+	TMap< NodeIdType, TArray< FBox > > NodePortals;
+
+	/*
+	Filled in on the game thread by AInteriorGraphActor::QueryCellCandidates, for every node to regenerate which
+	still exists. Nodes yet to be queried are pending.
+	*/
+	TMap< NodeIdType, FInteriorCellCandidates > CellCandidates;
+	TArray< NodeIdType > PendingQueries;
+};
+
+/*
+Shared between a running build and whoever is waiting on it.
+*/
+struct FInteriorGraphBuildProgress
+{
+	FThreadSafeCounter Completed;
+	FThreadSafeCounter Total;
+	FThreadSafeCounter Cancelled;
+
+	inline bool IsCancelled() const
+	{
+		return Cancelled.GetValue() != 0;
+	}
+
+	inline float GetFraction() const
+	{
+		auto const Tot = Total.GetValue();
+		return Tot > 0 ? (float)Completed.GetValue() / Tot : 0.f;
+	}
+};
+
@@ -0,0 +1,230 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "InteriorEditorPrivatePCH.h"
+#include "InteriorGraphBuildTask.h"
+#include "InteriorGraphBuildState.h"
+#include "InteriorGraphActor.h"
+#include "InteriorGraphInstance.h"
+#include "AsyncWork.h"
+#include "Ticker.h"
+
+
+// Game thread time spent on world queries per tick, in seconds
+static double const WorldQueryTimeSlice = 0.005;
+
+
+/*
+Runs AInteriorGraphActor::ExecuteBuild on a pool thread, using only the snapshot it was given, once the snapshot's
+world queries are done.
+*/
+class FInteriorGraphBuildWorker: public FNonAbandonableTask
+{
+public:
+	FInteriorGraphBuildWorker(
+		TSharedRef< FInteriorGraphBuildInput > InInput,
+		TSharedRef< FInteriorGraphBuildProgress > InProgress
+		):
+		Input(InInput),
+		Progress(InProgress)
+	{}
+
+	void DoWork()
+	{
+		Result = AInteriorGraphActor::ExecuteBuild(*Input, &Progress.Get());
+	}
+
+	FORCEINLINE TStatId GetStatId() const
+	{
+		RETURN_QUICK_DECLARE_CYCLE_STAT(FInteriorGraphBuildWorker, STATGROUP_ThreadPoolAsyncTasks);
+	}
+
+public:
+	TSharedRef< FInteriorGraphBuildInput > Input;
+	TSharedRef< FInteriorGraphBuildProgress > Progress;
+	TSharedPtr< FInteriorGraphInstance > Result;
+};
+
+
+FInteriorGraphBuildHandle::FInteriorGraphBuildHandle():
+World(nullptr),
+Generation(0),
+Task(nullptr),
+bComplete(false)
+{
+
+}
+
+FInteriorGraphBuildHandle::~FInteriorGraphBuildHandle()
+{
+	FTicker::GetCoreTicker().RemoveTicker(TickHandle);
+	FWorldDelegates::OnWorldCleanup.Remove(CleanupHandle);
+
+	if(Input.IsValid() && !bComplete)
+	{
+		// Nobody is waiting on the result any more
+		Progress->Cancelled.Set(1);
+		if(Task)
+		{
+			Task->EnsureCompletion();
+		}
+		HandOver();
+	}
+}
+
+void FInteriorGraphBuildHandle::Start(
+	AInteriorGraphActor* InGraph,
+	TSharedRef< FInteriorGraphBuildInput > InInput,
+	int32 InGeneration
+	)
+{
+	Graph = InGraph;
+	World = InGraph->GetWorld();
+	Generation = InGeneration;
+	Input = InInput;
+
+	Progress = MakeShareable(new FInteriorGraphBuildProgress);
+	AInteriorGraphActor::SelectBuild(*Input, Progress.Get());
+
+	TickHandle = FTicker::GetCoreTicker().AddTicker(
+		FTickerDelegate::CreateSP(this, &FInteriorGraphBuildHandle::Tick)
+		);
+	if(World)
+	{
+		CleanupHandle = FWorldDelegates::OnWorldCleanup.AddSP(this, &FInteriorGraphBuildHandle::OnWorldCleanup);
+	}
+}
+
+void FInteriorGraphBuildHandle::StartWorker()
+{
+	// The worker never touches the world, so is unaffected by its cleanup
+	FWorldDelegates::OnWorldCleanup.Remove(CleanupHandle);
+	World = nullptr;
+
+	Task = new FAsyncTask< FInteriorGraphBuildWorker >(Input.ToSharedRef(), Progress.ToSharedRef());
+	Task->StartBackgroundTask();
+}
+
+float FInteriorGraphBuildHandle::GetProgress() const
+{
+	return bComplete ? 1.f : Progress->GetFraction();
+}
+
+void FInteriorGraphBuildHandle::Cancel()
+{
+	Progress->Cancelled.Set(1);
+}
+
+bool FInteriorGraphBuildHandle::IsCancelled() const
+{
+	return Progress->IsCancelled();
+}
+
+bool FInteriorGraphBuildHandle::IsComplete() const
+{
+	return bComplete;
+}
+
+TSharedPtr< FInteriorGraphInstance > FInteriorGraphBuildHandle::GetResult() const
+{
+	return Result;
+}
+
+void FInteriorGraphBuildHandle::FinishWorldQueries()
+{
+	if(!bComplete && !Task && !IsCancelled())
+	{
+		AInteriorGraphActor::QueryCellCandidates(*Input, World, 0.0, Progress.Get());
+		StartWorker();
+	}
+}
+
+void FInteriorGraphBuildHandle::WaitForCompletion()
+{
+	if(!bComplete)
+	{
+		FinishWorldQueries();
+		if(Task)
+		{
+			Task->EnsureCompletion();
+		}
+		FTicker::GetCoreTicker().RemoveTicker(TickHandle);
+		Finish();
+	}
+}
+
+void FInteriorGraphBuildHandle::OnWorldCleanup(UWorld* InWorld, bool bSessionEnded, bool bCleanupResources)
+{
+	if(InWorld == World && !bComplete)
+	{
+		// The remaining queries can't be done without the world
+		Cancel();
+		WaitForCompletion();
+	}
+}
+
+bool FInteriorGraphBuildHandle::Tick(float DeltaTime)
+{
+	if(!Task && !IsCancelled())
+	{
+		if(AInteriorGraphActor::QueryCellCandidates(*Input, World, WorldQueryTimeSlice, Progress.Get()))
+		{
+			StartWorker();
+		}
+		return true;
+	}
+
+	if(Task && !Task->IsDone())
+	{
+		return true;
+	}
+
+	Finish();
+	return false;
+}
+
+void FInteriorGraphBuildHandle::Finish()
+{
+	check(IsInGameThread());
+
+	FWorldDelegates::OnWorldCleanup.Remove(CleanupHandle);
+	HandOver();
+	bComplete = true;
+
+	OnComplete.ExecuteIfBound(Result);
+}
+
+void FInteriorGraphBuildHandle::HandOver()
+{
+	// Only the handover of the results happens on the game thread
+	TSharedPtr< FInteriorGraphInstance > WorkerResult;
+	if(Task)
+	{
+		WorkerResult = Task->GetTask().Result;
+	}
+
+	if(Graph.IsValid())
+	{
+		if(WorkerResult.IsValid())
+		{
+			Graph->AdoptBuildState(Input->State, Generation);
+		}
+		else if(Task)
+		{
+			// Stopped part way, so the state is kept along with what is still to be built
+			Graph->AdoptBuildState(Input->State, Generation, &Input->DirtyNodes, &Input->DirtyConnections);
+		}
+		else
+		{
+			// Stopped before the worker started, so the state is untouched and everything selected is still to be built
+			Graph->AdoptBuildState(Input->State, Generation, &Input->NodesToBuild, &Input->ConnectionsToBuild);
+		}
+	}
+
+	if(!IsCancelled())
+	{
+		Result = WorkerResult;
+	}
+
+	delete Task;
+	Task = nullptr;
+}
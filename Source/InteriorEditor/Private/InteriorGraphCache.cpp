@@ -0,0 +1,125 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "InteriorEditorPrivatePCH.h"
+#include "InteriorGraphCache.h"
+#include "InteriorGraphInstance.h"
+#include "InteriorGraphBlob.h"
+#include "DerivedDataCacheInterface.h"
+#include "SecureHash.h"
+
+
+// Change this whenever the build algorithm or the instance serialization changes, to invalidate existing entries
+#define INTERIOR_GRAPH_DDC_VER TEXT("2F6C1D8A93E44B07A5D0C7E1B8342A9D")
+
+
+/*
+Component to world transform, composed from the serialized relative transforms. Components of a world which hasn't
+been initialized, as when cooking, aren't registered, so have no valid ComponentToWorld. Absolute transform flags and
+socket attachments are ignored.
+*/
+static FTransform GetUnregisteredComponentToWorld(USceneComponent const* Comp)
+{
+	auto Xform = FTransform::Identity;
+	for(auto C = Comp; C; C = C->AttachParent)
+	{
+		Xform = Xform * FTransform(C->RelativeRotation, C->RelativeLocation, C->RelativeScale3D);
+	}
+	return Xform;
+}
+
+void SerializeWorldCollisionForCacheKey(UWorld* World, FBox const& Bounds, AActor const* Graph, FArchive& Ar)
+{
+	if(!World)
+	{
+		return;
+	}
+
+	// Gather first so that the result does not depend on actor iteration order
+	TArray< FString > Entries;
+	for(TActorIterator< AActor > It(World); It; ++It)
+	{
+		// Meshes generated from the graph are placed owned by it, and must not invalidate its own builds
+		if(Graph && (*It == Graph || It->GetOwner() == Graph))
+		{
+			continue;
+		}
+
+		TArray< UPrimitiveComponent* > Components;
+		It->GetComponents(Components);
+
+		for(auto Comp : Components)
+		{
+			if(!Comp->IsCollisionEnabled() ||
+				Comp->GetCollisionResponseToChannel(ECollisionChannel::ECC_WorldStatic) != ECollisionResponse::ECR_Block)
+			{
+				continue;
+			}
+
+			auto const Xform = GetUnregisteredComponentToWorld(Comp);
+			auto const CompBox = Comp->CalcBounds(Xform).GetBox();
+			if(!CompBox.Intersect(Bounds))
+			{
+				continue;
+			}
+
+			/*
+			Object paths differ between the editor, play in editor and cooked copies of a level, so components are
+			described by class, mesh asset and placement only.
+			*/
+			auto const SMC = Cast< UStaticMeshComponent >(Comp);
+			auto const Mesh = SMC ? SMC->StaticMesh : nullptr;
+			Entries.Add(FString::Printf(
+				TEXT("%s|%s|%s|%s|%s|%s|%s"),
+				*Comp->GetClass()->GetPathName(),
+				Mesh ? *Mesh->GetPathName() : TEXT(""),
+				*Xform.GetLocation().ToString(),
+				*Xform.GetRotation().ToString(),
+				*Xform.GetScale3D().ToString(),
+				*CompBox.Min.ToString(),
+				*CompBox.Max.ToString()
+				));
+		}
+	}
+
+	Entries.Sort();
+	Ar << Entries;
+}
+
+FString MakeInteriorGraphCacheKey(TArray< uint8 > const& KeyData)
+{
+	uint8 Hash[20];
+	FSHA1::HashBuffer(KeyData.GetData(), KeyData.Num(), Hash);
+
+	return FDerivedDataCacheInterface::BuildCacheKey(
+		TEXT("INTERIORGRAPH"),
+		INTERIOR_GRAPH_DDC_VER,
+		*BytesToHex(Hash, sizeof(Hash))
+		);
+}
+
+bool GetCachedInteriorGraph(FString const& Key, FInteriorGraphInstance& Inst)
+{
+	TArray< uint8 > Data;
+	if(!GetDerivedDataCacheRef().GetSynchronous(*Key, Data))
+	{
+		return false;
+	}
+
+	FInteriorGraphBlob Blob;
+	if(!Blob.Initialize(Data.GetData(), Data.Num()))
+	{
+		return false;
+	}
+
+	Blob.ToInstance(Inst);
+	return true;
+}
+
+void PutCachedInteriorGraph(FString const& Key, FInteriorGraphInstance& Inst)
+{
+	TArray< uint8 > Data;
+	FInteriorGraphBlob::Write(Inst, Data);
+
+	GetDerivedDataCacheRef().Put(*Key, Data);
+}
+
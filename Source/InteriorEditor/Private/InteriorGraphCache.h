@@ -0,0 +1,24 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+
+/*
+Derived data cache support for built interior graph instances.
+*/
+
+/*
+Writes a description of the static world collision overlapping Bounds, sufficient to detect any change which could
+affect which cells a build considers hidden. Actors owned by Graph are skipped. The description is the same for the
+editor, play in editor and cooked copies of a level.
+*/
+void SerializeWorldCollisionForCacheKey(UWorld* World, FBox const& Bounds, class AActor const* Graph, FArchive& Ar);
+
+/*
+Creates a cache key from the serialized build inputs.
+*/
+FString MakeInteriorGraphCacheKey(TArray< uint8 > const& KeyData);
+
+bool GetCachedInteriorGraph(FString const& Key, class FInteriorGraphInstance& Inst);
+void PutCachedInteriorGraph(FString const& Key, class FInteriorGraphInstance& Inst);
+
@@ -0,0 +1,77 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "InteriorEditorPrivatePCH.h"
+#include "InteriorGraphChunking.h"
+
+
+void PartitionInteriorGraph(
+	FInteriorGraphInstance const& Inst,
+	float ChunkSize,
+	TArray< FInteriorGraphChunkBuild >& OutChunks
+	)
+{
+	OutChunks.Empty();
+	check(ChunkSize > 0.f);
+
+	auto const bHasOrigins = Inst.CellOrigins.Num() == Inst.NodeCount();
+
+	// Chunk index and chunk-local id of every cell
+	TMap< FInteriorChunkCoord, int32 > ChunkIndices;
+	TArray< int32 > CellChunks;
+	TArray< NodeIdType > LocalIds;
+	CellChunks.Empty(Inst.NodeCount());
+	LocalIds.Empty(Inst.NodeCount());
+
+	for(NodeIdType Id = 0; Id < Inst.NodeCount(); ++Id)
+	{
+		auto const& ND = Inst.NodeData[Id];
+		auto const Coord = FInteriorChunkCoord::FromPosition(ND.Box().GetCenter(), ChunkSize);
+
+		auto Existing = ChunkIndices.Find(Coord);
+		auto const ChunkIdx = Existing ? *Existing : OutChunks.Num();
+		if(!Existing)
+		{
+			ChunkIndices.Add(Coord, ChunkIdx);
+
+			FInteriorGraphChunkBuild NewChunk;
+			NewChunk.Coord = Coord;
+			OutChunks.Add(NewChunk);
+		}
+
+		auto& Chunk = OutChunks[ChunkIdx];
+		FNodeData Cell;
+		Cell.Min = ND.Min;
+		Cell.Max = ND.Max;
+
+		CellChunks.Add(ChunkIdx);
+		LocalIds.Add(Chunk.Inst.NodeData.Add(Cell));
+		if(bHasOrigins)
+		{
+			Chunk.Inst.CellOrigins.Add(Inst.CellOrigins[Id]);
+		}
+	}
+
+	for(auto const& CD : Inst.ConnData)
+	{
+		auto const SrcChunk = CellChunks[CD.Src];
+		auto const DestChunk = CellChunks[CD.Dest];
+		auto& Chunk = OutChunks[SrcChunk];
+
+		if(SrcChunk == DestChunk)
+		{
+			auto CId = Chunk.Inst.ConnData.Add(FConnectionData{ LocalIds[CD.Src], LocalIds[CD.Dest], CD.Portal });
+			Chunk.Inst.NodeData[LocalIds[CD.Src]].Outgoing.Add(CId);
+		}
+		else
+		{
+			FInteriorGraphBorderPortal BP;
+			BP.LocalNode = LocalIds[CD.Src];
+			BP.NeighbourChunk = OutChunks[DestChunk].Coord;
+			BP.NeighbourNode = LocalIds[CD.Dest];
+			BP.Portal = CD.Portal;
+			Chunk.BorderPortals.Add(BP);
+		}
+	}
+}
+
+
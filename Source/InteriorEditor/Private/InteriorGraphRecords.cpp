@@ -0,0 +1,497 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "InteriorEditorPrivatePCH.h"
+#include "InteriorGraphRecords.h"
+#include <cmath>
+
+
+namespace
+{
+	// Candidate grid sizes, largest first
+	const float GridSteps[] = {
+		1024.f, 512.f, 500.f, 256.f, 250.f, 200.f, 128.f, 100.f, 64.f, 50.f, 32.f, 25.f, 20.f, 16.f, 10.f, 8.f,
+		5.f, 4.f, 2.f, 1.f, 0.5f, 0.25f, 0.125f
+	};
+
+	// Quantized values are kept well inside the range in which a double represents every integer step exactly
+	const double MaxQuantized = (double)(1ll << 40);
+
+	inline uint64 ZigZag(int64 V)
+	{
+		return ((uint64)V << 1) ^ (uint64)(V >> 63);
+	}
+
+	inline int64 UnZigZag(uint64 V)
+	{
+		return (int64)(V >> 1) ^ -(int64)(V & 1);
+	}
+
+	inline int32 VarIntSize(uint64 V)
+	{
+		int32 Size = 1;
+		while(V >= 0x80)
+		{
+			V >>= 7;
+			++Size;
+		}
+		return Size;
+	}
+
+	inline bool BitwiseEqual(float A, float B)
+	{
+		return FMemory::Memcmp(&A, &B, sizeof(float)) == 0;
+	}
+
+	struct FGridAxis
+	{
+		double Origin;
+		double Step;
+
+		inline float Dequantize(int64 Q) const
+		{
+			return (float)(Origin + (double)Q * Step);
+		}
+
+		/*
+		Returns false if V does not lie exactly on the grid.
+		*/
+		inline bool Quantize(float V, int64& OutQ) const
+		{
+			auto const Qd = std::floor(((double)V - Origin) / Step + 0.5);
+			if(!(Qd > -MaxQuantized && Qd < MaxQuantized))
+			{
+				return false;
+			}
+
+			OutQ = (int64)Qd;
+			return BitwiseEqual(Dequantize(OutQ), V);
+		}
+	};
+
+	class FRecordWriter
+	{
+	public:
+		FRecordWriter(TArray< uint8 >& InData): Data(InData)
+		{}
+
+		void WriteUnsigned(uint64 V)
+		{
+			while(V >= 0x80)
+			{
+				Data.Add((uint8)(V | 0x80));
+				V >>= 7;
+			}
+			Data.Add((uint8)V);
+		}
+
+		void WriteSigned(int64 V)
+		{
+			WriteUnsigned(ZigZag(V));
+		}
+
+		void WriteFloat(float V)
+		{
+			uint32 Bits;
+			FMemory::Memcpy(&Bits, &V, sizeof(Bits));
+			for(int32 Byte = 0; Byte < 4; ++Byte)
+			{
+				Data.Add((uint8)(Bits >> (Byte * 8)));
+			}
+		}
+
+		/*
+		Writes V as a delta from Ref if it is on the grid, otherwise raw.
+		Returns the reference for subsequent values, which is unchanged if V was written raw.
+		*/
+		int64 WriteCoord(FGridAxis const& Axis, float V, int64 Ref)
+		{
+			int64 Q;
+			if(Axis.Quantize(V, Q))
+			{
+				WriteUnsigned(ZigZag(Q - Ref) << 1);
+				return Q;
+			}
+
+			WriteUnsigned(1);
+			WriteFloat(V);
+			return Ref;
+		}
+
+	protected:
+		TArray< uint8 >& Data;
+	};
+
+	class FRecordReader
+	{
+	public:
+		FRecordReader(TArray< uint8 > const& InData): Data(InData), Pos(0), bError(false)
+		{}
+
+		uint64 ReadUnsigned()
+		{
+			uint64 V = 0;
+			for(int32 Shift = 0; Shift < 64; Shift += 7)
+			{
+				if(Pos >= Data.Num())
+				{
+					bError = true;
+					return 0;
+				}
+
+				auto const Byte = Data[Pos++];
+				V |= (uint64)(Byte & 0x7f) << Shift;
+				if((Byte & 0x80) == 0)
+				{
+					return V;
+				}
+			}
+
+			bError = true;
+			return 0;
+		}
+
+		int64 ReadSigned()
+		{
+			return UnZigZag(ReadUnsigned());
+		}
+
+		float ReadFloat()
+		{
+			if(Pos + 4 > Data.Num())
+			{
+				bError = true;
+				return 0.f;
+			}
+
+			uint32 Bits = 0;
+			for(int32 Byte = 0; Byte < 4; ++Byte)
+			{
+				Bits |= (uint32)Data[Pos++] << (Byte * 8);
+			}
+
+			float V;
+			FMemory::Memcpy(&V, &Bits, sizeof(V));
+			return V;
+		}
+
+		float ReadCoord(FGridAxis const& Axis, int64 Ref, int64& OutRef)
+		{
+			auto const Tag = ReadUnsigned();
+			if(Tag & 1)
+			{
+				OutRef = Ref;
+				return ReadFloat();
+			}
+
+			auto const Delta = UnZigZag(Tag >> 1);
+			OutRef = Ref + Delta;
+			if(OutRef <= -(int64)MaxQuantized || OutRef >= (int64)MaxQuantized)
+			{
+				bError = true;
+			}
+			return Axis.Dequantize(OutRef);
+		}
+
+		inline bool IsError() const
+		{
+			return bError;
+		}
+
+		inline bool IsAtEnd() const
+		{
+			return Pos == Data.Num();
+		}
+
+	protected:
+		TArray< uint8 > const& Data;
+		int32 Pos;
+		bool bError;
+	};
+
+	inline uint64 SpreadBits(uint64 V)
+	{
+		V &= 0x1fffff;
+		V = (V | V << 32) & 0x1f00000000ffffull;
+		V = (V | V << 16) & 0x1f0000ff0000ffull;
+		V = (V | V << 8) & 0x100f00f00f00f00full;
+		V = (V | V << 4) & 0x10c30c30c30c30c3ull;
+		V = (V | V << 2) & 0x1249249249249249ull;
+		return V;
+	}
+
+	template < typename T >
+	void ApplyOrder(TArray< T >& Items, TArray< int32 > const& Order)
+	{
+		TArray< T > Reordered;
+		Reordered.Empty(Order.Num());
+		for(auto Idx : Order)
+		{
+			Reordered.Add(Items[Idx]);
+		}
+		Items = MoveTemp(Reordered);
+	}
+
+	/*
+	Picks the grid step expected to give the smallest encoding, trading the number of off-grid values against
+	the size of the deltas between neighbouring values.
+	*/
+	float ChooseGridStep(TArray< FPackedNodeRecord > const& NodeRecords, TArray< FPackedConnectionRecord > const& ConnectionRecords)
+	{
+		double AvgSize = 0.0;
+		for(auto const& NR : NodeRecords)
+		{
+			AvgSize += (NR.Max - NR.Min).GetMax();
+		}
+		AvgSize = NodeRecords.Num() > 0 ? AvgSize / NodeRecords.Num() : 1.0;
+
+		auto CountOffGrid = [](float V, double Step)
+		{
+			return std::fmod((double)V, Step) != 0.0 ? 1 : 0;
+		};
+
+		auto BestStep = GridSteps[0];
+		auto BestScore = MAX_dbl;
+		for(auto Step : GridSteps)
+		{
+			int64 NumOff = 0;
+			int64 NumValues = 0;
+			for(auto const& NR : NodeRecords)
+			{
+				for(int32 Axis = 0; Axis < 3; ++Axis)
+				{
+					NumOff += CountOffGrid(NR.Min[Axis], Step) + CountOffGrid(NR.Max[Axis], Step);
+				}
+				NumValues += 6;
+			}
+			for(auto const& CR : ConnectionRecords)
+			{
+				for(int32 Axis = 0; Axis < 3; ++Axis)
+				{
+					NumOff += CountOffGrid(CR.PortalMin[Axis], Step) + CountOffGrid(CR.PortalMax[Axis], Step);
+				}
+				NumValues += 6;
+			}
+
+			auto const DeltaBytes = VarIntSize(ZigZag((int64)(2.0 * AvgSize / Step)) << 1);
+			auto const Score = NumOff * 5.0 + (NumValues - NumOff) * (double)DeltaBytes;
+			if(Score < BestScore)
+			{
+				BestScore = Score;
+				BestStep = Step;
+			}
+		}
+
+		return BestStep;
+	}
+}
+
+
+void EncodeQuantizedRecords(
+	TArray< FPackedNodeRecord >& NodeRecords,
+	TArray< FPackedConnectionRecord >& ConnectionRecords,
+	TArray< uint8 >& OutData,
+	TArray< int32 >& OutNodeOrder,
+	TArray< int32 >& OutConnectionOrder
+	)
+{
+	auto const Step = ChooseGridStep(NodeRecords, ConnectionRecords);
+
+	FBox Bounds(0);
+	for(auto const& NR : NodeRecords)
+	{
+		Bounds += NR.Min;
+		Bounds += NR.Max;
+	}
+
+	// Snap the origin to the grid, so that on-grid values remain on-grid relative to it
+	FGridAxis Axes[3];
+	int64 OriginQ[3] = { 0, 0, 0 };
+	for(int32 Axis = 0; Axis < 3; ++Axis)
+	{
+		auto const Lo = Bounds.IsValid ? std::floor((double)Bounds.Min[Axis] / Step) : 0.0;
+		OriginQ[Axis] = FMath::Abs(Lo) < MaxQuantized ? (int64)Lo : 0;
+		Axes[Axis].Origin = (double)OriginQ[Axis] * Step;
+		Axes[Axis].Step = Step;
+	}
+
+	// Order nodes along a Morton curve of their minimum corner
+	TArray< uint64 > Keys;
+	Keys.Empty(NodeRecords.Num());
+	for(auto const& NR : NodeRecords)
+	{
+		uint64 Key = 0;
+		for(int32 Axis = 0; Axis < 3; ++Axis)
+		{
+			auto Cell = ((double)NR.Min[Axis] - Axes[Axis].Origin) / Step;
+			Cell = Cell > 0.0 ? FMath::Min(Cell, (double)0x1fffff) : 0.0;
+			Key |= SpreadBits((uint64)Cell) << Axis;
+		}
+		Keys.Add(Key);
+	}
+
+	OutNodeOrder.Empty(NodeRecords.Num());
+	for(int32 Idx = 0; Idx < NodeRecords.Num(); ++Idx)
+	{
+		OutNodeOrder.Add(Idx);
+	}
+	OutNodeOrder.Sort([&Keys](int32 A, int32 B)
+	{
+		return Keys[A] != Keys[B] ? Keys[A] < Keys[B] : A < B;
+	});
+	ApplyOrder(NodeRecords, OutNodeOrder);
+
+	TArray< int32 > NewNodeIndex;
+	NewNodeIndex.AddUninitialized(OutNodeOrder.Num());
+	for(int32 Idx = 0; Idx < OutNodeOrder.Num(); ++Idx)
+	{
+		NewNodeIndex[OutNodeOrder[Idx]] = Idx;
+	}
+
+	for(auto& CR : ConnectionRecords)
+	{
+		CR.Src = NewNodeIndex[CR.Src];
+		CR.Dest = NewNodeIndex[CR.Dest];
+	}
+
+	// Order connections by source node, keeping their relative order otherwise
+	OutConnectionOrder.Empty(ConnectionRecords.Num());
+	for(int32 Idx = 0; Idx < ConnectionRecords.Num(); ++Idx)
+	{
+		OutConnectionOrder.Add(Idx);
+	}
+	OutConnectionOrder.Sort([&ConnectionRecords](int32 A, int32 B)
+	{
+		auto const& CA = ConnectionRecords[A];
+		auto const& CB = ConnectionRecords[B];
+		return CA.Src != CB.Src ? CA.Src < CB.Src : A < B;
+	});
+	ApplyOrder(ConnectionRecords, OutConnectionOrder);
+
+	OutData.Empty();
+	FRecordWriter W(OutData);
+
+	W.WriteUnsigned(NodeRecords.Num());
+	W.WriteUnsigned(ConnectionRecords.Num());
+	W.WriteFloat(Step);
+	for(int32 Axis = 0; Axis < 3; ++Axis)
+	{
+		W.WriteSigned(OriginQ[Axis]);
+	}
+
+	// Per-node reference of the minimum corner, reused by the portals of its outgoing connections
+	TArray< int64 > MinRefs;
+	MinRefs.AddUninitialized(NodeRecords.Num() * 3);
+
+	int64 Prev[3] = { 0, 0, 0 };
+	for(int32 Idx = 0; Idx < NodeRecords.Num(); ++Idx)
+	{
+		auto const& NR = NodeRecords[Idx];
+		for(int32 Axis = 0; Axis < 3; ++Axis)
+		{
+			auto const MinRef = W.WriteCoord(Axes[Axis], NR.Min[Axis], Prev[Axis]);
+			W.WriteCoord(Axes[Axis], NR.Max[Axis], MinRef);
+
+			MinRefs[Idx * 3 + Axis] = MinRef;
+			Prev[Axis] = MinRef;
+		}
+	}
+
+	int32 PrevSrc = 0;
+	for(auto const& CR : ConnectionRecords)
+	{
+		W.WriteUnsigned(CR.Src - PrevSrc);
+		W.WriteSigned((int64)CR.Dest - CR.Src);
+		PrevSrc = CR.Src;
+
+		for(int32 Axis = 0; Axis < 3; ++Axis)
+		{
+			auto const PortalRef = W.WriteCoord(Axes[Axis], CR.PortalMin[Axis], MinRefs[CR.Src * 3 + Axis]);
+			W.WriteCoord(Axes[Axis], CR.PortalMax[Axis], PortalRef);
+		}
+	}
+}
+
+bool DecodeQuantizedRecords(
+	TArray< uint8 > const& Data,
+	TArray< FPackedNodeRecord >& NodeRecords,
+	TArray< FPackedConnectionRecord >& ConnectionRecords
+	)
+{
+	NodeRecords.Empty();
+	ConnectionRecords.Empty();
+
+	FRecordReader R(Data);
+
+	// Every record takes at least one byte per coordinate, which bounds the counts by the data size
+	auto const NumNodes = R.ReadUnsigned();
+	auto const NumConns = R.ReadUnsigned();
+	if(R.IsError() ||
+		NumNodes > (uint64)Data.Num() || NumNodes * 6 > (uint64)Data.Num() ||
+		NumConns > (uint64)Data.Num() || NumConns * 8 > (uint64)Data.Num())
+	{
+		return false;
+	}
+
+	auto const Step = R.ReadFloat();
+	if(R.IsError() || !(Step > 0.f) || !FMath::IsFinite(Step))
+	{
+		return false;
+	}
+
+	FGridAxis Axes[3];
+	for(int32 Axis = 0; Axis < 3; ++Axis)
+	{
+		auto const OriginQ = R.ReadSigned();
+		if(OriginQ <= -(int64)MaxQuantized || OriginQ >= (int64)MaxQuantized)
+		{
+			return false;
+		}
+		Axes[Axis].Origin = (double)OriginQ * Step;
+		Axes[Axis].Step = Step;
+	}
+
+	TArray< int64 > MinRefs;
+	MinRefs.AddUninitialized((int32)NumNodes * 3);
+
+	NodeRecords.AddUninitialized((int32)NumNodes);
+	int64 Prev[3] = { 0, 0, 0 };
+	for(int32 Idx = 0; Idx < (int32)NumNodes && !R.IsError(); ++Idx)
+	{
+		auto& NR = NodeRecords[Idx];
+		for(int32 Axis = 0; Axis < 3; ++Axis)
+		{
+			int64 MinRef, MaxRef;
+			NR.Min[Axis] = R.ReadCoord(Axes[Axis], Prev[Axis], MinRef);
+			NR.Max[Axis] = R.ReadCoord(Axes[Axis], MinRef, MaxRef);
+
+			MinRefs[Idx * 3 + Axis] = MinRef;
+			Prev[Axis] = MinRef;
+		}
+	}
+
+	ConnectionRecords.AddUninitialized((int32)NumConns);
+	uint64 Src = 0;
+	for(int32 Idx = 0; Idx < (int32)NumConns && !R.IsError(); ++Idx)
+	{
+		auto& CR = ConnectionRecords[Idx];
+		Src += R.ReadUnsigned();
+		auto const Dest = (int64)Src + R.ReadSigned();
+		if(Src >= NumNodes || Dest < 0 || Dest >= (int64)NumNodes)
+		{
+			return false;
+		}
+
+		CR.Src = (int32)Src;
+		CR.Dest = (int32)Dest;
+		for(int32 Axis = 0; Axis < 3; ++Axis)
+		{
+			int64 PortalRef, MaxRef;
+			CR.PortalMin[Axis] = R.ReadCoord(Axes[Axis], MinRefs[Src * 3 + Axis], PortalRef);
+			CR.PortalMax[Axis] = R.ReadCoord(Axes[Axis], PortalRef, MaxRef);
+		}
+	}
+
+	return !R.IsError() && R.IsAtEnd();
+}
+
+
@@ -0,0 +1,62 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+
+/*
+Packed on-disk records. Ids are reduced to 0-based with no gaps, so they are implied by position within the
+serialized arrays and needn't be stored. Outgoing lists are derived from the connections on load.
+*/
+struct FPackedNodeRecord
+{
+	FVector Min, Max;
+};
+
+inline FArchive& operator<< (FArchive& Ar, FPackedNodeRecord& Rec)
+{
+	Ar << Rec.Min << Rec.Max;
+	return Ar;
+}
+
+struct FPackedConnectionRecord
+{
+	int32 Src, Dest;
+	FVector PortalMin, PortalMax;
+};
+
+inline FArchive& operator<< (FArchive& Ar, FPackedConnectionRecord& Rec)
+{
+	Ar << Rec.Src << Rec.Dest << Rec.PortalMin << Rec.PortalMax;
+	return Ar;
+}
+
+
+/*
+Compact encoding of packed records.
+
+Coordinates are expressed in integer units of a grid chosen to fit the data, relative to the grid-snapped bounds of
+the graph. Nodes are reordered along a Morton curve and connections by source node, and each value is written as a
+variable length delta from its predecessor (node minimums from the previous node, maximums from their own minimum,
+portals from their source node). Values not exactly representable on the grid are written as raw floats, so the
+encoding is lossless.
+
+Reordering changes the packed ids, so the encoder reports the original index of each record in its new position.
+*/
+void EncodeQuantizedRecords(
+	TArray< FPackedNodeRecord >& NodeRecords,
+	TArray< FPackedConnectionRecord >& ConnectionRecords,
+	TArray< uint8 >& OutData,
+	TArray< int32 >& OutNodeOrder,
+	TArray< int32 >& OutConnectionOrder
+	);
+
+/*
+Returns false if the data is malformed.
+*/
+bool DecodeQuantizedRecords(
+	TArray< uint8 > const& Data,
+	TArray< FPackedNodeRecord >& NodeRecords,
+	TArray< FPackedConnectionRecord >& ConnectionRecords
+	);
+
+
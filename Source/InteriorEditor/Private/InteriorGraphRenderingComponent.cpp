@@ -109,23 +109,23 @@ FGraphSceneProxy::FGraphSceneProxy(
 	{
 		Graph = Cast< AInteriorGraphActor >(RenderComp->GetOwner());
 
-		for(auto const& Nd : Graph->NodeMap)
+		Graph->ForEachNode([this](NodeIdType Id, int32 Idx)
 		{
 			FNodeInfo NI;
-			NI.Id = Nd.Key;
-			NI.Box = Graph->NodeData[Nd.Value].Box();
+			NI.Id = Id;
+			NI.Box = Graph->NodeData[Idx].Box();
 			NodeInfo.Add(std::move(NI));
-		}
+		});
 
-		for(auto const& Cn : Graph->ConnectionMap)
+		Graph->ForEachConnection([this](ConnectionIdType Id, int32 Idx)
 		{
 			FConnInfo CI;
-			CI.Id = Cn.Key;
-			CI.PortalBox = Graph->GetConnectionData(Cn.Value).Portal;
+			CI.Id = Id;
+			CI.PortalBox = Graph->ConnData[Idx].Portal;
 			auto Sz = CI.PortalBox.GetSize();
 			CI.Axis = Sz.X == 0.f ? EAxisIndex::X : (Sz.Y == 0.f ? EAxisIndex::Y : EAxisIndex::Z);
 			ConnInfo.Add(std::move(CI));
-		}
+		});
 
 		//Mat = Graph->Mat;
 		Mat = UMaterial::GetDefaultMaterial(EMaterialDomain::MD_Surface);
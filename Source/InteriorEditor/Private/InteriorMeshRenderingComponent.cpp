@@ -2,103 +2,384 @@
 
 #include "InteriorEditorPrivatePCH.h"
 #include "InteriorMeshRenderingComponent.h"
-#include "InteriorGraphInstance.h"
-#include "InteriorEditorMode.h" 
+#include "InteriorGraphActor.h"
+#include "InteriorEditorConversion.h"
+#include "InteriorEditorUtil.h"
+#include "DynamicMeshBuilder.h"
 
-#include <algorithm>
+
+// Chunk size used for preview conversion, independent of the graph's export settings
+const float PreviewChunkSize = 2000.f;
+
+// Floor, wall and ceiling
+const int32 NumPreviewMaterials = 3;
+
+
+class FInteriorMeshVertexBuffer: public FVertexBuffer
+{
+public:
+	TArray< FDynamicMeshVertex > Vertices;
+
+	virtual void InitRHI() override
+	{
+		auto const Size = Vertices.Num() * sizeof(FDynamicMeshVertex);
+		FRHIResourceCreateInfo CreateInfo;
+		VertexBufferRHI = RHICreateVertexBuffer(Size, BUF_Static, CreateInfo);
+
+		auto Data = RHILockVertexBuffer(VertexBufferRHI, 0, Size, RLM_WriteOnly);
+		FMemory::Memcpy(Data, Vertices.GetData(), Size);
+		RHIUnlockVertexBuffer(VertexBufferRHI);
+	}
+};
+
+class FInteriorMeshIndexBuffer: public FIndexBuffer
+{
+public:
+	TArray< int32 > Indices;
+
+	virtual void InitRHI() override
+	{
+		auto const Size = Indices.Num() * sizeof(int32);
+		FRHIResourceCreateInfo CreateInfo;
+		IndexBufferRHI = RHICreateIndexBuffer(sizeof(int32), Size, BUF_Static, CreateInfo);
+
+		auto Data = RHILockIndexBuffer(IndexBufferRHI, 0, Size, RLM_WriteOnly);
+		FMemory::Memcpy(Data, Indices.GetData(), Size);
+		RHIUnlockIndexBuffer(IndexBufferRHI);
+	}
+};
+
+class FInteriorMeshVertexFactory: public FLocalVertexFactory
+{
+public:
+	void Init(FInteriorMeshVertexBuffer const* VertexBuffer)
+	{
+		check(!IsInRenderingThread());
+
+		ENQUEUE_UNIQUE_RENDER_COMMAND_TWOPARAMETER(
+			InitInteriorMeshVertexFactory,
+			FInteriorMeshVertexFactory*, VertexFactory, this,
+			FInteriorMeshVertexBuffer const*, VertexBuffer, VertexBuffer,
+			{
+				DataType NewData;
+				NewData.PositionComponent = STRUCTMEMBER_VERTEXSTREAMCOMPONENT(VertexBuffer, FDynamicMeshVertex, Position, VET_Float3);
+				NewData.TextureCoordinates.Add(
+					FVertexStreamComponent(VertexBuffer, STRUCT_OFFSET(FDynamicMeshVertex, TextureCoordinate), sizeof(FDynamicMeshVertex), VET_Float2)
+					);
+				NewData.TangentBasisComponents[0] = STRUCTMEMBER_VERTEXSTREAMCOMPONENT(VertexBuffer, FDynamicMeshVertex, TangentX, VET_PackedNormal);
+				NewData.TangentBasisComponents[1] = STRUCTMEMBER_VERTEXSTREAMCOMPONENT(VertexBuffer, FDynamicMeshVertex, TangentZ, VET_PackedNormal);
+				NewData.ColorComponent = STRUCTMEMBER_VERTEXSTREAMCOMPONENT(VertexBuffer, FDynamicMeshVertex, Color, VET_Color);
+				VertexFactory->SetData(NewData);
+			});
+	}
+};
+
+
+/*
+GPU resources for one converted section, with the triangles of each material contiguous in the index buffer.
+*/
+struct FInteriorMeshSectionResources
+{
+	FInteriorMeshVertexBuffer VertexBuffer;
+	FInteriorMeshIndexBuffer IndexBuffer;
+	FInteriorMeshVertexFactory VertexFactory;
+
+	// First index and number of triangles, per material
+	int32 FirstIndex[NumPreviewMaterials];
+	int32 NumTriangles[NumPreviewMaterials];
+
+	void Release()
+	{
+		VertexBuffer.ReleaseResource();
+		IndexBuffer.ReleaseResource();
+		VertexFactory.ReleaseResource();
+	}
+};
+
+/*
+Sections are shared between the component and its proxies, so the last reference may be dropped on either thread.
+Resources have to be released on the rendering thread, and no proxy can still be using them by then.
+*/
+static void DestroySectionResources(FInteriorMeshSectionResources* Section)
+{
+	if(IsInRenderingThread())
+	{
+		Section->Release();
+		delete Section;
+	}
+	else
+	{
+		ENQUEUE_UNIQUE_RENDER_COMMAND_ONEPARAMETER(
+			DestroyInteriorMeshSection,
+			FInteriorMeshSectionResources*, Section, Section,
+			{
+				Section->Release();
+				delete Section;
+			});
+	}
+}
+
+/*
+Builds the vertex and index data for a converted section, and begins initializing its resources.
+Returns null if the section has no geometry.
+*/
+static FInteriorMeshSectionRef CreateSectionResources(FRawMesh const& Mesh)
+{
+	auto const NumFaces = Mesh.FaceMaterialIndices.Num();
+	if(NumFaces == 0)
+	{
+		return nullptr;
+	}
+
+	auto Section = new FInteriorMeshSectionResources;
+	// Faces are flat, so a vertex is shared only between the wedges of faces with the same smoothing group
+	TMap< uint64, int32 > WedgeVertices;
+	TArray< int32 > MaterialIndices[NumPreviewMaterials];
+	auto& Vertices = Section->VertexBuffer.Vertices;
+	for(int32 Face = 0; Face < NumFaces; ++Face)
+	{
+		auto const Wedge = Face * 3;
+		// Smoothing group identifies the face axis and direction, and faces point into their node
+		auto const FaceMaskIdx = (int32)FMath::FloorLog2(Mesh.FaceSmoothingMasks[Face]);
+		auto const Axis = (EAxisIndex)(FaceMaskIdx % EAxisIndex::Count);
+		auto Normal = FVector::ZeroVector;
+		Normal[Axis] = FaceMaskIdx < EAxisIndex::Count ? -1.f : 1.f;
+		auto Tangent = FVector::ZeroVector;
+		Tangent[FMath::Min(FAxisUtils::OtherAxes[Axis][0], FAxisUtils::OtherAxes[Axis][1])] = 1.f;
+
+		auto const MatIdx = FMath::Clamp(Mesh.FaceMaterialIndices[Face], 0, NumPreviewMaterials - 1);
+		for(int32 Corner = 0; Corner < 3; ++Corner)
+		{
+			auto const VIdx = Mesh.WedgeIndices[Wedge + Corner];
+			auto const Key = ((uint64)Mesh.FaceSmoothingMasks[Face] << 32) | VIdx;
+
+			auto Existing = WedgeVertices.Find(Key);
+			if(!Existing)
+			{
+				FDynamicMeshVertex Vert;
+				Vert.Position = Mesh.VertexPositions[VIdx];
+				Vert.TextureCoordinate = Mesh.WedgeTexCoords[0][Wedge + Corner];
+				Vert.SetTangents(Tangent, Normal ^ Tangent, Normal);
+				Vert.Color = FColor::White;
+				Existing = &WedgeVertices.Add(Key, Vertices.Add(Vert));
+			}
+			MaterialIndices[MatIdx].Add(*Existing);
+		}
+	}
+
+	auto& Indices = Section->IndexBuffer.Indices;
+	Indices.Empty(NumFaces * 3);
+	for(int32 MatIdx = 0; MatIdx < NumPreviewMaterials; ++MatIdx)
+	{
+		Section->FirstIndex[MatIdx] = Indices.Num();
+		Section->NumTriangles[MatIdx] = MaterialIndices[MatIdx].Num() / 3;
+		Indices.Append(MaterialIndices[MatIdx]);
+	}
+
+	Section->VertexFactory.Init(&Section->VertexBuffer);
+	BeginInitResource(&Section->VertexBuffer);
+	BeginInitResource(&Section->IndexBuffer);
+	BeginInitResource(&Section->VertexFactory);
+
+	return FInteriorMeshSectionRef(Section, &DestroySectionResources);
+}
 
 
 class FGraphMeshSceneProxy: public FPrimitiveSceneProxy
 {
 public:
 	FGraphMeshSceneProxy(
-		const UPrimitiveComponent* InComponent
+		const UPrimitiveComponent* InComponent,
+		TArray< FInteriorMeshSectionRef > const& InSections
 		);
 
 	virtual FPrimitiveViewRelevance GetViewRelevance(const FSceneView* View) override;
-	virtual void DrawStaticElements(FStaticPrimitiveDrawInterface* PDI) const override;
+	virtual void DrawStaticElements(FStaticPrimitiveDrawInterface* PDI) override;
+	virtual uint32 GetMemoryFootprint() const override;
 
 protected:
-	FRawMesh Mesh;
+	// Owned jointly with the component, which keeps them from one proxy to the next
+	TArray< FInteriorMeshSectionRef > Sections;
+	UMaterialInterface* Materials[NumPreviewMaterials];
+	FMaterialRelevance MaterialRelevance;
 };
 
 
 FGraphMeshSceneProxy::FGraphMeshSceneProxy(
-	const UPrimitiveComponent* InComponent
+	const UPrimitiveComponent* InComponent,
+	TArray< FInteriorMeshSectionRef > const& InSections
 	):
-	FPrimitiveSceneProxy(InComponent)
+	FPrimitiveSceneProxy(InComponent),
+	Sections(InSections)
 {
-	auto RenderComp = Cast< UInteriorMeshRenderingComponent >(InComponent);
-	if(RenderComp)
+	for(int32 MatIdx = 0; MatIdx < NumPreviewMaterials; ++MatIdx)
 	{
-		auto Graph = Cast< AInteriorGraphActor >(RenderComp->GetOwner());
-
-		// store instance id in render component
-		// store instance pointers inside graph actor
-		// generate raw mesh here and store, then render in DrawStaticElements()
+		Materials[MatIdx] = InComponent->GetMaterial(MatIdx);
+		if(!Materials[MatIdx])
+		{
+			Materials[MatIdx] = UMaterial::GetDefaultMaterial(EMaterialDomain::MD_Surface);
+		}
 	}
+	MaterialRelevance = InComponent->GetMaterialRelevance(GetScene().GetFeatureLevel());
 }
 
 FPrimitiveViewRelevance FGraphMeshSceneProxy::GetViewRelevance(const FSceneView* View)
 {
 	FPrimitiveViewRelevance Result;
 	Result.bDrawRelevance = IsShown(View);
+	Result.bShadowRelevance = IsShadowCast(View);
 	Result.bStaticRelevance = true;
 	Result.bDynamicRelevance = false;
-	Result.bNormalTranslucencyRelevance = IsShown(View);
+	Result.bRenderInMainPass = ShouldRenderInMainPass();
+	MaterialRelevance.SetPrimitiveViewRelevance(Result);
 	return Result;
 }
 
-void FGraphMeshSceneProxy::DrawStaticElements(FStaticPrimitiveDrawInterface* PDI) const
+void FGraphMeshSceneProxy::DrawStaticElements(FStaticPrimitiveDrawInterface* PDI)
 {
+	for(auto const& SectionRef : Sections)
+	{
+		auto const& Section = *SectionRef;
+		for(int32 MatIdx = 0; MatIdx < NumPreviewMaterials; ++MatIdx)
+		{
+			if(Section.NumTriangles[MatIdx] == 0)
+			{
+				continue;
+			}
+
+			FMeshBatch Mesh;
+			Mesh.VertexFactory = &Section.VertexFactory;
+			Mesh.MaterialRenderProxy = Materials[MatIdx]->GetRenderProxy(false);
+			Mesh.ReverseCulling = IsLocalToWorldDeterminantNegative();
+			Mesh.Type = PT_TriangleList;
+			Mesh.DepthPriorityGroup = SDPG_World;
 
+			auto& Element = Mesh.Elements[0];
+			// Static elements don't get the primitive's uniform buffer assigned, as dynamic ones do
+			Element.PrimitiveUniformBufferResource = &GetUniformBuffer();
+			Element.IndexBuffer = &Section.IndexBuffer;
+			Element.FirstIndex = Section.FirstIndex[MatIdx];
+			Element.NumPrimitives = Section.NumTriangles[MatIdx];
+			Element.MinVertexIndex = 0;
+			Element.MaxVertexIndex = Section.VertexBuffer.Vertices.Num() - 1;
+
+			PDI->DrawMesh(Mesh, FLT_MAX);
+		}
+	}
+}
+
+uint32 FGraphMeshSceneProxy::GetMemoryFootprint() const
+{
+	auto Size = sizeof(*this) + GetAllocatedSize();
+	for(auto const& Section : Sections)
+	{
+		// Shared with the component, and possibly the previous proxy
+		Size += sizeof(*Section) +
+			Section->VertexBuffer.Vertices.GetAllocatedSize() +
+			Section->IndexBuffer.Indices.GetAllocatedSize();
+	}
+	return Size;
 }
 
 
 UInteriorMeshRenderingComponent::UInteriorMeshRenderingComponent(FObjectInitializer const& OI):
-Super(OI)
+Super(OI),
+PreviewBounds(0)
 {
+	// Converted geometry is in world space
+	bAbsoluteLocation = true;
+	bAbsoluteRotation = true;
+	bAbsoluteScale = true;
 }
 
-FPrimitiveSceneProxy* UInteriorMeshRenderingComponent::CreateSceneProxy()
+void UInteriorMeshRenderingComponent::UpdatePreview()
 {
-	auto Graph = Cast< AInteriorGraphActor >(GetOwner());
-	if(Graph)
-	{
-		return new FGraphMeshSceneProxy(this);
-	}
-	else
+	if(RefreshPreviewCache())
 	{
-		return nullptr;
+		UpdateBounds();
+		MarkRenderStateDirty();
 	}
 }
 
-FBoxSphereBounds UInteriorMeshRenderingComponent::CalcBounds(const FTransform& LocalToWorld) const
+void UInteriorMeshRenderingComponent::OnRegister()
 {
-	// TODO:
-	static FBox BoundingBox(FVector(-HALF_WORLD_MAX), FVector(HALF_WORLD_MAX));
-	return FBoxSphereBounds(BoundingBox);
+	Super::OnRegister();
+
+	// Render state is created after this, so no need to mark it dirty
+	RefreshPreviewCache();
 }
 
-void UInteriorMeshRenderingComponent::CreateRenderState_Concurrent()
+bool UInteriorMeshRenderingComponent::RefreshPreviewCache()
 {
-	Super::CreateRenderState_Concurrent();
+	auto Graph = Cast< AInteriorGraphActor >(GetOwner());
+	if(!Graph || !Graph->bPreviewMesh)
+	{
+		auto const bHadPreview = PreviewCache.IsValid();
+		PreviewCache.Reset();
+		SectionResources.Empty();
+		PreviewBounds = FBox(0);
+		return bHadPreview;
+	}
+
+	if(!PreviewCache.IsValid())
+	{
+		// Only the visible geometry is needed
+		PreviewCache = MakeShareable(new FInteriorMeshConversionCache(EInteriorMeshPartition::Grid, PreviewChunkSize, FString(), 0.f));
+	}
+
+	// Only the sections which were reconverted need new resources
+	auto const Changed = PreviewCache->Update(Graph);
+	for(auto const& Coord : Changed)
+	{
+		auto Section = PreviewCache->GetSections().Find(Coord);
+		auto Resources = Section ? CreateSectionResources(Section->Mesh) : nullptr;
+		if(Resources.IsValid())
+		{
+			SectionResources.Add(Coord, Resources);
+		}
+		else
+		{
+			SectionResources.Remove(Coord);
+		}
+	}
 
-	if(SceneProxy)
+	if(Changed.Num() > 0)
 	{
-		static_cast<FGraphMeshSceneProxy*>(SceneProxy)->RegisterDebugDrawDelgate();
+		PreviewBounds = FBox(0);
+		for(auto const& Entry : PreviewCache->GetSections())
+		{
+			PreviewBounds += FBox(Entry.Value.Mesh.VertexPositions);
+		}
 	}
+
+	return Changed.Num() > 0;
 }
 
-void UInteriorMeshRenderingComponent::DestroyRenderState_Concurrent()
+FPrimitiveSceneProxy* UInteriorMeshRenderingComponent::CreateSceneProxy()
 {
-	if(SceneProxy)
+	if(SectionResources.Num() == 0)
 	{
-		static_cast<FGraphMeshSceneProxy*>(SceneProxy)->UnregisterDebugDrawDelgate();
+		return nullptr;
 	}
 
-	Super::DestroyRenderState_Concurrent();
+	TArray< FInteriorMeshSectionRef > Sections;
+	SectionResources.GenerateValueArray(Sections);
+	return new FGraphMeshSceneProxy(this, Sections);
+}
+
+FBoxSphereBounds UInteriorMeshRenderingComponent::CalcBounds(const FTransform& LocalToWorld) const
+{
+	return FBoxSphereBounds(PreviewBounds.IsValid ? PreviewBounds : FBox(FVector::ZeroVector, FVector::ZeroVector));
+}
+
+int32 UInteriorMeshRenderingComponent::GetNumMaterials() const
+{
+	return NumPreviewMaterials;
 }
 
+UMaterialInterface* UInteriorMeshRenderingComponent::GetMaterial(int32 ElementIndex) const
+{
+	return UMaterial::GetDefaultMaterial(EMaterialDomain::MD_Surface);
+}
 
 
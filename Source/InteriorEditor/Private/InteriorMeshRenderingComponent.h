@@ -4,12 +4,18 @@
 
 #include "Components/PrimitiveComponent.h"
 #include "PrimitiveSceneProxy.h"
+#include "InteriorGraphChunkActor.h"
 
 #include "InteriorMeshRenderingComponent.generated.h"
 
 
+struct FInteriorMeshSectionResources;
+typedef TSharedPtr< FInteriorMeshSectionResources, ESPMode::ThreadSafe > FInteriorMeshSectionRef;
+
 /**
- * 
+ * Draws the geometry which static mesh generation would produce from the owning graph, without creating an asset.
+ * Conversion is chunked and retained between updates, as are the GPU resources of each chunk, so after an edit only the
+ * affected chunks are reconverted and uploaded.
  */
 UCLASS(hidecategories = Object)
 class UInteriorMeshRenderingComponent : public UPrimitiveComponent
@@ -20,10 +26,30 @@ public:
 	UInteriorMeshRenderingComponent(FObjectInitializer const& OI);
 
 public:
+	/*
+	Reconverts whatever has changed in the graph since the last update, and refreshes the proxy if anything did.
+	Should be called after edits to the graph, not for changes that can't affect its geometry, such as selection.
+	*/
+	void UpdatePreview();
 
 public:
 	virtual FPrimitiveSceneProxy* CreateSceneProxy() override;
 	virtual FBoxSphereBounds CalcBounds(const FTransform &LocalToWorld) const override;
-	virtual void CreateRenderState_Concurrent() override;
-	virtual void DestroyRenderState_Concurrent() override;
+	virtual int32 GetNumMaterials() const override;
+	virtual UMaterialInterface* GetMaterial(int32 ElementIndex) const override;
+	virtual void OnRegister() override;
+
+protected:
+	/*
+	Brings the cache and section resources up to date, returning whether anything changed.
+	*/
+	bool RefreshPreviewCache();
+
+protected:
+	TSharedPtr< class FInteriorMeshConversionCache > PreviewCache;
+	// Resources of each chunk with geometry, handed to every proxy created
+	TMap< FInteriorChunkCoord, FInteriorMeshSectionRef > SectionResources;
+	FBox PreviewBounds;
 };
+
+
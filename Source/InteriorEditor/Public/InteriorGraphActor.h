@@ -3,13 +3,11 @@
 #pragma once
 
 #include "InteriorGraphTypes.h"
+#include "InteriorGraphBuildSettings.h"
 #include "Set.h"
 #include "InteriorGraphActor.generated.h"
 
 
-#define INTERIOR_GRAPH_DEBUG_NAMES 1
-
-
 struct FConnectionKey
 {
 	NodeIdType Src;
@@ -54,6 +52,29 @@ struct FConnKeyFuncs: BaseKeyFuncs< class AInteriorConnectionActor*, FConnection
 };
 #endif
 
+/*
+How static mesh generation splits up the geometry of a graph.
+*/
+UENUM()
+namespace EInteriorMeshPartition
+{
+	enum Type
+	{
+		// A single asset for the whole graph
+		Single,
+		// One asset per cubic chunk of MeshChunkSize, each placed in the level with its own actor
+		Grid,
+		// One asset per node, each placed in the level with its own actor
+		PerNode,
+		// Nodes are converted in batches, and written out to a new asset whenever the current one reaches
+		// MeshMemoryLimit, so the raw mesh data held during conversion does not depend on the size of the graph.
+		// Each asset is saved as it is written, and only its render data is kept, for its placed actor.
+		// Nothing is retained between generations.
+		Streamed,
+	};
+}
+
+
 /*
 Actor representing the interior graph.
 */
@@ -72,6 +93,62 @@ public:
 	//UPROPERTY()
 	TArray< FConnectionData > ConnData;
 
+	/*
+	Save node and connection coordinates in quantized, delta encoded form (losslessly), rather than as raw floats.
+	*/
+	UPROPERTY(EditAnywhere, Category = "Serialization")
+	bool bCompactSerialization;
+
+	/*
+	Touching nodes are separate spaces unless joined by a portal, so by default static mesh conversion emits the
+	wall between them on both sides. If set, touching nodes are instead treated as one continuous space, and the
+	faces they share are omitted from both.
+	*/
+	UPROPERTY(EditAnywhere, Category = "Conversion")
+	bool bCullSharedFaces;
+
+	/*
+	Unless Single, static mesh generation writes one asset per partition. For Grid and PerNode, later generations
+	only rebuild the partitions affected by edits in between.
+	*/
+	UPROPERTY(EditAnywhere, Category = "Conversion")
+	TEnumAsByte< EInteriorMeshPartition::Type > MeshPartition;
+
+	UPROPERTY(EditAnywhere, Category = "Conversion", Meta = (ClampMin = "1"))
+	float MeshChunkSize;
+
+	/*
+	Streamed partitioning: the approximate size in megabytes of raw mesh data accumulated before it is written out.
+	*/
+	UPROPERTY(EditAnywhere, Category = "Conversion", Meta = (ClampMin = "1"))
+	int32 MeshMemoryLimit;
+
+	/*
+	Draw the geometry that static mesh generation would produce, kept up to date while editing.
+	*/
+	UPROPERTY(EditAnywhere, Category = "Conversion")
+	bool bPreviewMesh;
+
+	/*
+	Give generated static meshes simple box collision, a slab behind each wall, floor and ceiling area, rather than
+	per triangle collision.
+	*/
+	UPROPERTY(EditAnywhere, Category = "Conversion")
+	bool bBoxCollision;
+
+	/*
+	Thickness of the box collision slab behind each area.
+	*/
+	UPROPERTY(EditAnywhere, Category = "Conversion", Meta = (ClampMin = "1", EditCondition = "bBoxCollision"))
+	float CollisionThickness;
+
+	/*
+	Identifies the graph to its stored graph actor and to chunk actors split from it, see StoreGraph and
+	BuildAndStoreChunks.
+	*/
+	UPROPERTY(VisibleAnywhere, Category = "Streaming")
+	FGuid GraphId;
+
 public:
 	AInteriorGraphActor();
 
@@ -108,17 +185,95 @@ public:
 	void SetNodeData(NodeIdType id, FNodeData&& ND);
 	void SetConnectionData(ConnectionIdType id, FConnectionData&& CD);
 
-	TSharedPtr< class FInteriorGraphInstance > BuildGraph(int32 Subdivision = 1, int32 SubdivisionZ = 1);
+	/*
+	Builds a runtime graph instance by subdividing every node into cells.
+	If bIncremental is set and a previous build with the same settings exists, only the cells of nodes and
+	connections which have been modified since that build are regenerated.
+	*/
+	TSharedPtr< class FInteriorGraphInstance > BuildGraph(FInteriorGraphBuildSettings const& Settings, bool bIncremental = true);
+	TSharedPtr< class FInteriorGraphInstance > BuildGraph(int32 Subdivision = 1, int32 SubdivisionZ = 1, bool bIncremental = true);
+	/*
+	As BuildGraph, but snapshots the graph and performs the build over the following ticks. World queries are
+	time-sliced on the game thread, and the rest is done on a worker thread.
+	The result is delivered on the game thread via the returned handle.
+	*/
+	TSharedRef< class FInteriorGraphBuildHandle > BuildGraphAsync(FInteriorGraphBuildSettings const& Settings, bool bIncremental = true);
+	/*
+	As BuildGraph, but first looks for an identical build in the derived data cache, keyed on the nodes, connections,
+	settings and overlapping static world collision. Builds and stores the result on a miss.
+	*/
+	TSharedPtr< class FInteriorGraphInstance > BuildGraphCached(FInteriorGraphBuildSettings const& Settings);
+	/*
+	As BuildGraphCached, but returns null on a miss rather than building.
+	*/
+	TSharedPtr< class FInteriorGraphInstance > FindCachedGraph(FInteriorGraphBuildSettings const& Settings) const;
+	/*
+	Ids differ between the editor, play in editor and cooked copies of a level, so the key refers to nodes by their
+	position in a canonical order instead, as do cached builds. OutNodeOrder receives the ids in that order.
+	*/
+	FString GetBuildCacheKey(FInteriorGraphBuildSettings const& Settings, TArray< NodeIdType >* OutNodeOrder = nullptr) const;
+	/*
+	Discards any retained build state, forcing the next BuildGraph to rebuild from scratch.
+	*/
+	void InvalidateBuildState();
+
+	/*
+	Builds the graph (via the derived data cache) and stores the packed result in an AInteriorStoredGraphActor in the
+	same level, so that it is saved with the level and can be loaded at runtime without rebuilding. Any later edit to
+	the graph discards it. Undoable.
+	*/
+	bool BuildAndStoreGraph(FInteriorGraphBuildSettings const& Settings);
+	/*
+	Stores an already built instance, as BuildAndStoreGraph. The instance should be a build of the graph's current state
+	with the given settings.
+	*/
+	bool StoreGraph(TSharedPtr< class FInteriorGraphInstance > Inst, FInteriorGraphBuildSettings const& Settings);
+	/*
+	If a build was stored but has since been discarded by edits, stores one with the same settings again, taken from
+	the derived data cache. On a miss, builds only if bAllowBuild is set. Not undoable, this is meant for copies of the
+	level which aren't saved back, when playing in editor and cooking. Returns whether a build is now stored.
+	*/
+	bool RefreshStoredGraph(bool bAllowBuild);
+	/*
+	Settings of the last stored build, or null if nothing has ever been stored. Kept when edits discard the build.
+	*/
+	FInteriorGraphBuildSettings const* GetStoredBuildSettings() const;
+	void ClearStoredGraph();
+	bool HasStoredGraph() const;
+	/*
+	The stored build, as held by the stored graph actor. Both are null if nothing is stored.
+	*/
+	class FInteriorGraphBlob const* GetStoredGraphBlob() const;
+	TSharedPtr< class FInteriorGraphInstance > GetStoredGraph();
+	/*
+	Builds the graph and splits the result into cubic chunks of ChunkSize, each stored in its own chunk actor, which
+	can then be moved into a streaming level. Existing chunk actors of this graph in loaded levels are replaced.
+	Returns the number of chunks created.
+	*/
+	int32 BuildAndStoreChunks(FInteriorGraphBuildSettings const& Settings, float ChunkSize);
+
+#if WITH_EDITOR
+	/*
+	Retained state of the last chunked static mesh generation, see ConvertInteriorGraphToSMAsset.
+	*/
+	TSharedPtr< class FInteriorMeshConversionCache >& GetMeshConversionCache();
+#endif
 
 private:
 	ConnectionIdType FindFirstConnection(FConnectionKey const& Key) const;
 	ConnectionIdType CreateConnection(NodeIdType N1, NodeIdType N2, FAxisAlignedPlanarArea const& area);
-	void GetPackedData(
-		TArray< FNodeData >& PackedNodes,
-		TArray< FConnectionData >& PackedConnections,
-		TArray< FString >& NodeNameAr,
-		TArray< FString >& ConnNameAr
+	void GetPackedRecords(
+		TArray< struct FPackedNodeRecord >& NodeRecords,
+		TArray< struct FPackedConnectionRecord >& ConnectionRecords,
+		TArray< FString >* NodeNameAr,
+		TArray< FString >* ConnNameAr
 		) const;
+	void LoadPackedRecords(
+		TArray< struct FPackedNodeRecord > const& NodeRecords,
+		TArray< struct FPackedConnectionRecord > const& ConnectionRecords,
+		TArray< FString > const* NodeNameAr,
+		TArray< FString > const* ConnNameAr
+		);
 
 /*	inline NodeIdType GetNodeId(const FNodeData* nd) const
 	{
@@ -126,21 +281,172 @@ private:
 	}
 */
 
-	static void RemoveHiddenNodes(
-		TMap< NodeIdType, FNodeData >& BuildND,
-		TMap< ConnectionIdType, FConnectionData >& BuildCD,
-		UWorld* World
+	/*
+	Id to index mapping, valid whether or not ids are currently identity mapped
+	*/
+	int32 NodeIndex(NodeIdType Id) const;
+	int32 ConnectionIndex(ConnectionIdType Id) const;
+	bool HasNode(NodeIdType Id) const;
+	bool HasConnection(ConnectionIdType Id) const;
+	int32 NumNodes() const;
+	int32 NumConnections() const;
+	/*
+	Leaves identity mode, populating NodeMap/ConnectionMap. Must be called before any removal.
+	*/
+	void MaterializeIdMaps();
+
+	/*
+	Invokes Fn(Id, Index) for every live node/connection.
+	*/
+	template < typename TFn >
+	inline void ForEachNode(TFn Fn) const
+	{
+		if(bIdentityIds)
+		{
+			for(int32 Idx = 0; Idx < NodeData.Num(); ++Idx)
+			{
+				Fn((NodeIdType)Idx, Idx);
+			}
+		}
+		else
+		{
+			for(auto const& Entry : NodeMap)
+			{
+				Fn(Entry.Key, Entry.Value);
+			}
+		}
+	}
+
+	template < typename TFn >
+	inline void ForEachConnection(TFn Fn) const
+	{
+		if(bIdentityIds)
+		{
+			for(int32 Idx = 0; Idx < ConnData.Num(); ++Idx)
+			{
+				Fn((ConnectionIdType)Idx, Idx);
+			}
+		}
+		else
+		{
+			for(auto const& Entry : ConnectionMap)
+			{
+				Fn(Entry.Key, Entry.Value);
+			}
+		}
+	}
+
+	void MarkNodeDirty(NodeIdType Id);
+	void MarkConnectionDirty(ConnectionIdType Id);
+
+	/*
+	Fills in a build input snapshot, handing over any reusable build state. Returns the build generation.
+	*/
+	int32 MakeBuildInput(FInteriorGraphBuildSettings const& Settings, bool bIncremental, struct FInteriorGraphBuildInput& Input);
+	/*
+	Retains the state resulting from a build, unless another build or an invalidation has happened since it began.
+	A cancelled build passes the nodes and connections it didn't finish, which are marked dirty again along with
+	any edited since.
+	*/
+	void AdoptBuildState(
+		TSharedPtr< struct FInteriorGraphBuildState > State,
+		int32 Generation,
+		TSet< NodeIdType > const* UnbuiltNodes = nullptr,
+		TSet< ConnectionIdType > const* UnbuiltConnections = nullptr
+		);
+	/*
+	Works out which original nodes and connections the build regenerates, and which nodes need their cell candidates
+	querying. Creates the build state if there is none to update.
+	*/
+	static void SelectBuild(struct FInteriorGraphBuildInput& Input, struct FInteriorGraphBuildProgress* Progress);
+	/*
+	Queries the world for the cell candidates of the selected nodes, for up to TimeLimit seconds, or until done if it
+	is zero. Game thread only. Returns true once every node has been queried.
+	*/
+	static bool QueryCellCandidates(
+		struct FInteriorGraphBuildInput& Input,
+		UWorld* World,
+		double TimeLimit,
+		struct FInteriorGraphBuildProgress* Progress
+		);
+	/*
+	Performs the rest of the build described by the snapshot, once its cell candidates have been queried. Accesses
+	neither the actor nor the world, so is safe to call from any thread.
+	Returns null if cancelled via Progress, in which case the input's dirty sets are replaced with whatever still
+	needs building on top of its partially updated state.
+	*/
+	static TSharedPtr< FInteriorGraphInstance > ExecuteBuild(
+		struct FInteriorGraphBuildInput& Input,
+		struct FInteriorGraphBuildProgress* Progress
+		);
+
+	static void FindCellCandidates(
+		FInteriorGraphBuildSettings const& Settings,
+		FNodeData const& ND,
+		TArray< FBox > const& Portals,
+		UWorld* World,
+		struct FInteriorCellCandidates& OutCandidates
+		);
+	static void FindHiddenCells(TArray< FBox > const& Boxes, UWorld* World, TBitArray<>& OutHidden);
+	static void SubdivideAdaptive(
+		FBox const& Box,
+		FInteriorGraphBuildSettings const& Settings,
+		TArray< FBox > const& Portals,
+		UWorld* World,
+		TArray< FBox >& OutCells
 		);
 	static void PackNodeAndConnectionData(
 		TSharedPtr< FInteriorGraphInstance > Inst,
-		TMap< NodeIdType, FNodeData >& BuildND,
-		TMap< ConnectionIdType, FConnectionData >& BuildCD
+		TMap< NodeIdType, FNodeData > const& BuildND,
+		TMap< ConnectionIdType, FConnectionData > const& BuildCD,
+		TMap< NodeIdType, FInteriorCellOrigin > const& CellOrigins
+		);
+
+	/*
+	Incremental build helpers, operating on the retained build state
+	*/
+	static void BuildNodeCells(
+		struct FInteriorGraphBuildState& State,
+		NodeIdType OrigId,
+		struct FInteriorCellCandidates const& Candidates
+		);
+	static void BuildUniformNodeCells(
+		struct FInteriorGraphBuildState& State,
+		NodeIdType OrigId,
+		struct FInteriorCellCandidates const& Candidates
+		);
+	static void MergeAdjacentCells(TArray< FBox >& Cells);
+	static void AddNodeCellBoxes(
+		struct FInteriorGraphBuildState& State,
+		NodeIdType OrigId,
+		struct FInteriorCellCandidates const& Candidates
 		);
+	static void ConnectAdjacentCells(
+		struct FInteriorGraphBuildState& State,
+		TArray< NodeIdType > const& Cells,
+		TArray< ConnectionIdType >& OutIds
+		);
+	static void BuildConnectionPortals(
+		struct FInteriorGraphBuildState& State,
+		ConnectionIdType OrigId,
+		FConnectionData const& CD
+		);
+	static void RemoveNodeCells(struct FInteriorGraphBuildState& State, NodeIdType OrigId);
+	static void RemoveConnectionPortals(struct FInteriorGraphBuildState& State, ConnectionIdType OrigId);
+	static bool ConnectCells(
+		struct FInteriorGraphBuildState& State,
+		NodeIdType N1,
+		NodeIdType N2,
+		FAxisAlignedPlanarArea const& Area,
+		TArray< ConnectionIdType >& OutIds
+		);
+	static void RemoveCellConnection(struct FInteriorGraphBuildState& State, ConnectionIdType CId);
 
 public:
 	// Overrides
 	virtual void Serialize(FArchive& Ar) override;
 	virtual void PreInitializeComponents() override;
+	virtual void PreSave() override;
 
 	static void AddReferencedObjects(UObject* InThis, FReferenceCollector& Collector);
 
@@ -155,8 +461,33 @@ protected:
 	*/
 	TMap< NodeIdType, int32 > NodeMap;
 	TMap< ConnectionIdType, int32 > ConnectionMap;
+	/*
+	While set, every id is equal to its index and the maps above are left empty. This is the case after a load,
+	until the first removal, since nothing else can introduce gaps.
+	*/
+	bool bIdentityIds;
+
+	/*
+	Nodes and connections which have been added, modified or removed since the last BuildGraph.
+	*/
+	TSet< NodeIdType > DirtyNodes;
+	TSet< ConnectionIdType > DirtyConnections;
+	TSharedPtr< struct FInteriorGraphBuildState > BuildState;
+	int32 BuildGeneration;
+
+	TSharedPtr< class FInteriorMeshConversionCache > MeshConversionCache;
 #endif
 
+	/*
+	Holder of the stored build, see BuildAndStoreGraph.
+	*/
+	UPROPERTY()
+	class AInteriorStoredGraphActor* StoredGraphActor;
+	/*
+	Settings the stored build was made with, see RefreshStoredGraph.
+	*/
+	FInteriorGraphBuildSettings StoredBuildSettings;
+
 #if INTERIOR_GRAPH_DEBUG_NAMES
 public:
 	TMap< NodeIdType, FString > NodeNames;
@@ -164,6 +495,8 @@ public:
 #endif
 
 	friend class FGraphSceneProxy;
+	friend class FInteriorGraphBuildHandle;
+	friend class FInteriorGraphBuildWorker;
 };
 
 
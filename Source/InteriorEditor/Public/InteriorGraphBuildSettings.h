@@ -0,0 +1,116 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+
+enum class EInteriorSubdivisionMode {
+	// Every node is cut into the same number of cells, regardless of its size
+	Uniform,
+	// Nodes are recursively halved (octree-style) until cells reach a target size, with further refinement
+	// close to portals and static geometry
+	Adaptive,
+};
+
+/*
+Parameters controlling how AInteriorGraphActor::BuildGraph turns nodes into cells.
+*/
+struct FInteriorGraphBuildSettings
+{
+	EInteriorSubdivisionMode Mode;
+
+	// Uniform: number of cells along each horizontal axis, and along Z, for every node
+	int32 Subdivision;
+	int32 SubdivisionZ;
+
+	// Adaptive: cells are split until no larger than this along any axis
+	float TargetCellSize;
+	// Adaptive: cells are never split below this size along any axis
+	float MinCellSize;
+	// Adaptive: cells within this distance of a portal are refined down to MinCellSize
+	float PortalRefineDistance;
+	// Adaptive: cells partially overlapping static world geometry are refined down to MinCellSize
+	bool bRefineNearGeometry;
+
+	// After hidden cells are removed, greedily merge the surviving cells of each node into maximal boxes
+	bool bMergeCells;
+
+	// Format debug names for every cell at build time, rather than generating them on demand.
+	// Does not affect the generated cells.
+	bool bEagerDebugNames;
+
+	FInteriorGraphBuildSettings():
+		Mode(EInteriorSubdivisionMode::Uniform),
+		Subdivision(1),
+		SubdivisionZ(1),
+		TargetCellSize(400.f),
+		MinCellSize(50.f),
+		PortalRefineDistance(50.f),
+		bRefineNearGeometry(true),
+		bMergeCells(false),
+		bEagerDebugNames(false)
+	{}
+
+	static inline FInteriorGraphBuildSettings Uniform(int32 InSubdivision, int32 InSubdivisionZ)
+	{
+		FInteriorGraphBuildSettings Settings;
+		Settings.Mode = EInteriorSubdivisionMode::Uniform;
+		Settings.Subdivision = InSubdivision;
+		Settings.SubdivisionZ = InSubdivisionZ;
+		return Settings;
+	}
+
+	static inline FInteriorGraphBuildSettings Adaptive(float InTargetCellSize, float InMinCellSize)
+	{
+		FInteriorGraphBuildSettings Settings;
+		Settings.Mode = EInteriorSubdivisionMode::Adaptive;
+		Settings.TargetCellSize = InTargetCellSize;
+		Settings.MinCellSize = InMinCellSize;
+		Settings.PortalRefineDistance = InMinCellSize;
+		return Settings;
+	}
+
+	/*
+	True if builds using the two settings generate identical cells, meaning build state can be reused.
+	*/
+	inline bool operator== (FInteriorGraphBuildSettings const& Rhs) const
+	{
+		if(Mode != Rhs.Mode || bMergeCells != Rhs.bMergeCells)
+		{
+			return false;
+		}
+
+		switch(Mode)
+		{
+			case EInteriorSubdivisionMode::Uniform:
+			return Subdivision == Rhs.Subdivision &&
+				SubdivisionZ == Rhs.SubdivisionZ;
+
+			case EInteriorSubdivisionMode::Adaptive:
+			return TargetCellSize == Rhs.TargetCellSize &&
+				MinCellSize == Rhs.MinCellSize &&
+				PortalRefineDistance == Rhs.PortalRefineDistance &&
+				bRefineNearGeometry == Rhs.bRefineNearGeometry;
+
+			default:
+			return false;
+		}
+	}
+
+	inline bool operator!= (FInteriorGraphBuildSettings const& Rhs) const
+	{
+		return !(*this == Rhs);
+	}
+};
+
+inline FArchive& operator<< (FArchive& Ar, FInteriorGraphBuildSettings& Settings)
+{
+	auto Mode = (uint8)Settings.Mode;
+	Ar << Mode;
+	Settings.Mode = (EInteriorSubdivisionMode)Mode;
+
+	Ar << Settings.Subdivision << Settings.SubdivisionZ;
+	Ar << Settings.TargetCellSize << Settings.MinCellSize << Settings.PortalRefineDistance << Settings.bRefineNearGeometry;
+	Ar << Settings.bMergeCells << Settings.bEagerDebugNames;
+	return Ar;
+}
+
@@ -0,0 +1,92 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "InteriorGraphBaseTypes.h"
+
+
+template< typename TTask >
+class FAsyncTask;
+
+DECLARE_DELEGATE_OneParam(FOnInteriorGraphBuilt, TSharedPtr< class FInteriorGraphInstance >);
+
+
+/*
+Handle to a graph build running in the background, as returned by AInteriorGraphActor::BuildGraphAsync.
+The build first queries the world for cell candidates on the game thread, a slice at a time each tick, then does the
+rest on a worker thread which never touches the world.
+All members should be accessed from the game thread only. The result becomes available, and OnComplete is
+invoked, on the game thread once the worker has finished.
+*/
+class INTERIOREDITOR_API FInteriorGraphBuildHandle: public TSharedFromThis< FInteriorGraphBuildHandle >
+{
+public:
+	FInteriorGraphBuildHandle();
+	~FInteriorGraphBuildHandle();
+
+public:
+	/*
+	Fraction of the build completed so far, in [0, 1].
+	*/
+	float GetProgress() const;
+
+	/*
+	Requests that the build stop as soon as possible. OnComplete will still be invoked, with a null instance.
+	Anything the build didn't get to remains dirty for the next incremental build.
+	This happens automatically if the world being built in is cleaned up before its queries are done.
+	*/
+	void Cancel();
+	bool IsCancelled() const;
+
+	/*
+	True once the result has been delivered on the game thread.
+	*/
+	bool IsComplete() const;
+	TSharedPtr< class FInteriorGraphInstance > GetResult() const;
+
+	/*
+	Does any remaining world queries immediately, rather than over the following ticks, so that the worker starts.
+	*/
+	void FinishWorldQueries();
+
+	/*
+	Finishes the world queries, blocks until the worker has finished, then delivers the result immediately.
+	*/
+	void WaitForCompletion();
+
+public:
+	FOnInteriorGraphBuilt OnComplete;
+
+private:
+	void Start(
+		class AInteriorGraphActor* Graph,
+		TSharedRef< struct FInteriorGraphBuildInput > Input,
+		int32 Generation
+		);
+	bool Tick(float DeltaTime);
+	void OnWorldCleanup(class UWorld* InWorld, bool bSessionEnded, bool bCleanupResources);
+	void StartWorker();
+	void Finish();
+	/*
+	Passes the result and build state on, and deletes the worker, if it was started.
+	*/
+	void HandOver();
+
+private:
+	TWeakObjectPtr< class AInteriorGraphActor > Graph;
+	// Only set until the world queries are done
+	class UWorld* World;
+	int32 Generation;
+
+	TSharedPtr< struct FInteriorGraphBuildInput > Input;
+	TSharedPtr< struct FInteriorGraphBuildProgress > Progress;
+	FAsyncTask< class FInteriorGraphBuildWorker >* Task;
+	FDelegateHandle TickHandle;
+	FDelegateHandle CleanupHandle;
+
+	bool bComplete;
+	TSharedPtr< class FInteriorGraphInstance > Result;
+
+	friend class AInteriorGraphActor;
+};
+
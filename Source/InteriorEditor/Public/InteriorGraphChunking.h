@@ -0,0 +1,30 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "InteriorGraphInstance.h"
+#include "InteriorGraphChunkActor.h"
+
+
+/*
+Result of splitting a built instance into chunks.
+*/
+struct FInteriorGraphChunkBuild
+{
+	FInteriorChunkCoord Coord;
+	// Cells whose centre lies within the chunk, and the connections between them, with chunk-local ids
+	FInteriorGraphInstance Inst;
+	TArray< FInteriorGraphBorderPortal > BorderPortals;
+};
+
+/*
+Assigns every cell of the instance to the chunk containing its centre.
+Connections between cells of different chunks become border portals of the source cell's chunk.
+*/
+INTERIOREDITOR_API void PartitionInteriorGraph(
+	FInteriorGraphInstance const& Inst,
+	float ChunkSize,
+	TArray< FInteriorGraphChunkBuild >& OutChunks
+	);
+
+
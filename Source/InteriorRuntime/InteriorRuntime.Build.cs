@@ -0,0 +1,18 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+using UnrealBuildTool;
+
+public class InteriorRuntime : ModuleRules
+{
+    public InteriorRuntime(TargetInfo Target)
+	{
+        PublicDependencyModuleNames.AddRange(
+            new string[]
+            {
+                "Core",
+				"CoreUObject",
+				"Engine"
+            }
+        );
+	}
+}
@@ -1,6 +1,6 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
-#include "InteriorEditorPrivatePCH.h"
+#include "InteriorRuntimePrivatePCH.h"
 #include "InteriorEditorUtil.h"
 
 
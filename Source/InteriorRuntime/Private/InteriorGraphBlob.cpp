@@ -0,0 +1,279 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "InteriorRuntimePrivatePCH.h"
+#include "InteriorGraphBlob.h"
+
+
+static_assert(sizeof(FInteriorGraphBlobBox) == 24, "Blob layout changed");
+static_assert(sizeof(FInteriorGraphBlobConnection) == 32, "Blob layout changed");
+static_assert(sizeof(FInteriorCellOrigin) == 16, "Blob layout changed");
+static_assert(sizeof(FInteriorGraphBlobHeader) == 40, "Blob layout changed");
+
+
+// 'IGRB'
+const uint32 FInteriorGraphBlob::Magic = 0x42524749;
+const uint32 FInteriorGraphBlob::Version = 1;
+
+
+FInteriorGraphBlob::FInteriorGraphBlob():
+Base(nullptr),
+Header(nullptr),
+NodeBounds(nullptr),
+OutgoingRows(nullptr),
+Outgoing(nullptr),
+Connections(nullptr),
+CellOrigins(nullptr)
+{
+
+}
+
+void FInteriorGraphBlob::Write(FInteriorGraphInstance const& Inst, TArray< uint8 >& OutData)
+{
+	auto const NumNodes = (uint32)Inst.NodeCount();
+	auto const NumConns = (uint32)Inst.ConnectionCount();
+
+	uint32 NumOutgoing = 0;
+	for(auto const& ND : Inst.NodeData)
+	{
+		NumOutgoing += ND.Outgoing.Num();
+	}
+
+	// Every section holds 4-byte elements, so no padding is required between them
+	FInteriorGraphBlobHeader Hdr;
+	Hdr.Magic = Magic;
+	Hdr.Version = Version;
+	Hdr.NodeCount = NumNodes;
+	Hdr.ConnectionCount = NumConns;
+	Hdr.NodeBoundsOffset = sizeof(FInteriorGraphBlobHeader);
+	Hdr.OutgoingRowsOffset = Hdr.NodeBoundsOffset + NumNodes * sizeof(FInteriorGraphBlobBox);
+	Hdr.OutgoingOffset = Hdr.OutgoingRowsOffset + (NumNodes + 1) * sizeof(uint32);
+	Hdr.ConnectionsOffset = Hdr.OutgoingOffset + NumOutgoing * sizeof(int32);
+	Hdr.CellOriginsOffset = Hdr.ConnectionsOffset + NumConns * sizeof(FInteriorGraphBlobConnection);
+	Hdr.TotalSize = Hdr.CellOriginsOffset + NumNodes * sizeof(FInteriorCellOrigin);
+
+	OutData.Empty(Hdr.TotalSize);
+	OutData.AddZeroed(Hdr.TotalSize);
+	auto Data = OutData.GetData();
+
+	FMemory::Memcpy(Data, &Hdr, sizeof(Hdr));
+
+	auto Bounds = reinterpret_cast< FInteriorGraphBlobBox* >(Data + Hdr.NodeBoundsOffset);
+	auto Rows = reinterpret_cast< uint32* >(Data + Hdr.OutgoingRowsOffset);
+	auto Out = reinterpret_cast< int32* >(Data + Hdr.OutgoingOffset);
+	uint32 Row = 0;
+	for(uint32 Idx = 0; Idx < NumNodes; ++Idx)
+	{
+		auto const& ND = Inst.NodeData[Idx];
+		Bounds[Idx] = FInteriorGraphBlobBox::FromBox(ND.Box());
+
+		Rows[Idx] = Row;
+		for(auto CId : ND.Outgoing)
+		{
+			Out[Row++] = CId;
+		}
+	}
+	Rows[NumNodes] = Row;
+
+	auto Conns = reinterpret_cast< FInteriorGraphBlobConnection* >(Data + Hdr.ConnectionsOffset);
+	for(uint32 Idx = 0; Idx < NumConns; ++Idx)
+	{
+		auto const& CD = Inst.ConnData[Idx];
+		Conns[Idx].Src = CD.Src;
+		Conns[Idx].Dest = CD.Dest;
+		Conns[Idx].Portal = FInteriorGraphBlobBox::FromBox(CD.Portal);
+	}
+
+	// Origins may be absent, for instance if the instance was not produced by a build
+	auto Origins = reinterpret_cast< FInteriorCellOrigin* >(Data + Hdr.CellOriginsOffset);
+	if(Inst.CellOrigins.Num() == (int32)NumNodes)
+	{
+		FMemory::Memcpy(Origins, Inst.CellOrigins.GetData(), NumNodes * sizeof(FInteriorCellOrigin));
+	}
+	else
+	{
+		for(uint32 Idx = 0; Idx < NumNodes; ++Idx)
+		{
+			Origins[Idx] = FInteriorCellOrigin{ NullNode, (int32)Idx, INDEX_NONE, INDEX_NONE };
+		}
+	}
+}
+
+bool FInteriorGraphBlob::Initialize(const uint8* Data, int64 Size)
+{
+	Base = nullptr;
+	Header = nullptr;
+
+	if(!Data ||
+		Size < (int64)sizeof(FInteriorGraphBlobHeader) ||
+		(UPTRINT(Data) & 3) != 0)
+	{
+		return false;
+	}
+
+	auto Hdr = reinterpret_cast< const FInteriorGraphBlobHeader* >(Data);
+	if(Hdr->Magic != Magic || Hdr->Version != Version || Hdr->TotalSize > Size)
+	{
+		return false;
+	}
+
+	// Check the sections are where the counts say they should be. Counts are untrusted, so use 64 bit math.
+	auto const NumNodes = (uint64)Hdr->NodeCount;
+	auto const NumConns = (uint64)Hdr->ConnectionCount;
+	if(Hdr->NodeBoundsOffset != sizeof(FInteriorGraphBlobHeader) ||
+		Hdr->OutgoingRowsOffset != Hdr->NodeBoundsOffset + NumNodes * sizeof(FInteriorGraphBlobBox) ||
+		Hdr->OutgoingOffset != Hdr->OutgoingRowsOffset + (NumNodes + 1) * sizeof(uint32) ||
+		Hdr->OutgoingOffset > Hdr->ConnectionsOffset ||
+		(Hdr->ConnectionsOffset - Hdr->OutgoingOffset) % sizeof(int32) != 0 ||
+		Hdr->CellOriginsOffset != Hdr->ConnectionsOffset + NumConns * sizeof(FInteriorGraphBlobConnection) ||
+		Hdr->TotalSize != Hdr->CellOriginsOffset + NumNodes * sizeof(FInteriorCellOrigin))
+	{
+		return false;
+	}
+
+	auto const NumOutgoing = (uint64)(Hdr->ConnectionsOffset - Hdr->OutgoingOffset) / sizeof(int32);
+
+	auto Rows = reinterpret_cast< const uint32* >(Data + Hdr->OutgoingRowsOffset);
+	if(Rows[0] != 0 || Rows[NumNodes] != NumOutgoing)
+	{
+		return false;
+	}
+	for(uint64 Idx = 0; Idx < NumNodes; ++Idx)
+	{
+		if(Rows[Idx] > Rows[Idx + 1])
+		{
+			return false;
+		}
+	}
+
+	auto Conns = reinterpret_cast< const FInteriorGraphBlobConnection* >(Data + Hdr->ConnectionsOffset);
+	for(uint64 Idx = 0; Idx < NumConns; ++Idx)
+	{
+		if(Conns[Idx].Src < 0 || (uint64)Conns[Idx].Src >= NumNodes ||
+			Conns[Idx].Dest < 0 || (uint64)Conns[Idx].Dest >= NumNodes)
+		{
+			return false;
+		}
+	}
+
+	// Every connection in a node's row must actually leave that node
+	auto Out = reinterpret_cast< const int32* >(Data + Hdr->OutgoingOffset);
+	for(uint64 Node = 0; Node < NumNodes; ++Node)
+	{
+		for(auto Idx = Rows[Node]; Idx < Rows[Node + 1]; ++Idx)
+		{
+			if(Out[Idx] < 0 || (uint64)Out[Idx] >= NumConns || (uint64)Conns[Out[Idx]].Src != Node)
+			{
+				return false;
+			}
+		}
+	}
+
+	Base = Data;
+	Header = Hdr;
+	NodeBounds = Section< FInteriorGraphBlobBox >(Hdr->NodeBoundsOffset);
+	OutgoingRows = Rows;
+	Outgoing = Out;
+	Connections = Conns;
+	CellOrigins = Section< FInteriorCellOrigin >(Hdr->CellOriginsOffset);
+	return true;
+}
+
+bool FInteriorGraphBlob::IsValid() const
+{
+	return Header != nullptr;
+}
+
+void FInteriorGraphBlob::ToInstance(FInteriorGraphInstance& Inst) const
+{
+	check(IsValid());
+
+	Inst.NodeData.SetNum(NodeCount());
+	for(NodeIdType Id = 0; Id < NodeCount(); ++Id)
+	{
+		auto& ND = Inst.NodeData[Id];
+		auto Box = GetNodeBox(Id);
+		ND.Min = Box.Min;
+		ND.Max = Box.Max;
+
+		int32 NumOut = 0;
+		auto Out = GetNodeOutConnections(Id, NumOut);
+		ND.Outgoing.Empty(NumOut);
+		ND.Outgoing.Append(Out, NumOut);
+	}
+
+	Inst.ConnData.SetNum(ConnectionCount());
+	for(ConnectionIdType Id = 0; Id < ConnectionCount(); ++Id)
+	{
+		Inst.ConnData[Id] = GetConnectionData(Id);
+	}
+
+	Inst.CellOrigins.Empty(NodeCount());
+	Inst.CellOrigins.Append(CellOrigins, NodeCount());
+}
+
+int32 FInteriorGraphBlob::NodeCount() const
+{
+	return Header ? (int32)Header->NodeCount : 0;
+}
+
+int32 FInteriorGraphBlob::ConnectionCount() const
+{
+	return Header ? (int32)Header->ConnectionCount : 0;
+}
+
+FBox FInteriorGraphBlob::GetNodeBox(NodeIdType Id) const
+{
+	check(Id >= 0 && Id < NodeCount());
+	return NodeBounds[Id].ToBox();
+}
+
+FConnectionData FInteriorGraphBlob::GetConnectionData(ConnectionIdType Id) const
+{
+	check(Id >= 0 && Id < ConnectionCount());
+	auto const& Conn = Connections[Id];
+	return FConnectionData{ Conn.Src, Conn.Dest, Conn.Portal.ToBox() };
+}
+
+FInteriorCellOrigin const& FInteriorGraphBlob::GetCellOrigin(NodeIdType Id) const
+{
+	check(Id >= 0 && Id < NodeCount());
+	return CellOrigins[Id];
+}
+
+const ConnectionIdType* FInteriorGraphBlob::GetNodeOutConnections(NodeIdType Id, int32& OutNum) const
+{
+	check(Id >= 0 && Id < NodeCount());
+	OutNum = (int32)(OutgoingRows[Id + 1] - OutgoingRows[Id]);
+	return Outgoing + OutgoingRows[Id];
+}
+
+NodeIdList FInteriorGraphBlob::GetAdjacentNodes(NodeIdType Id) const
+{
+	int32 NumOut = 0;
+	auto Out = GetNodeOutConnections(Id, NumOut);
+
+	NodeIdList Adj;
+	Adj.Reserve(NumOut);
+	for(int32 Idx = 0; Idx < NumOut; ++Idx)
+	{
+		Adj.Add(Connections[Out[Idx]].Dest);
+	}
+	return Adj;
+}
+
+NodeIdType FInteriorGraphBlob::GetNodeFromPosition(FVector const& Pos) const
+{
+	// todo: naive, as with FInteriorGraphInstance
+	for(NodeIdType Id = 0; Id < NodeCount(); ++Id)
+	{
+		auto const& B = NodeBounds[Id];
+		if(Pos.X >= B.Min[0] && Pos.X < B.Max[0] &&
+			Pos.Y >= B.Min[1] && Pos.Y < B.Max[1] &&
+			Pos.Z >= B.Min[2] && Pos.Z < B.Max[2])
+		{
+			return Id;
+		}
+	}
+	return NullNode;
+}
+
@@ -0,0 +1,105 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "InteriorRuntimePrivatePCH.h"
+#include "InteriorGraphChunkActor.h"
+#include "InteriorGraphStreaming.h"
+#include "InteriorGraphBlob.h"
+#include "InteriorGraphCustomVersion.h"
+
+
+AInteriorGraphChunkActor::AInteriorGraphChunkActor(FObjectInitializer const& OI):
+Super(OI)
+, ChunkSize(0.f)
+, Coord{ 0, 0, 0 }
+, Reach(0)
+{
+
+}
+
+void AInteriorGraphChunkActor::SetChunkData(
+	FInteriorChunkCoord const& InCoord,
+	FInteriorGraphInstance const& Inst,
+	TArray< FInteriorGraphBorderPortal > const& InBorderPortals
+	)
+{
+	Coord = InCoord;
+	FInteriorGraphBlob::Write(Inst, ChunkData);
+	BorderPortals = InBorderPortals;
+	BindBlob();
+}
+
+FInteriorGraphBlob const* AInteriorGraphChunkActor::GetBlob() const
+{
+	return Blob.Get();
+}
+
+int32 AInteriorGraphChunkActor::GetReach() const
+{
+	return Reach;
+}
+
+void AInteriorGraphChunkActor::BindBlob()
+{
+	Blob.Reset();
+	Reach = 0;
+
+	auto NewBlob = MakeShareable(new FInteriorGraphBlob);
+	if(!NewBlob->Initialize(ChunkData.GetData(), ChunkData.Num()))
+	{
+		return;
+	}
+
+	Blob = NewBlob;
+	if(ChunkSize > 0.f)
+	{
+		for(NodeIdType Id = 0; Id < Blob->NodeCount(); ++Id)
+		{
+			auto const Box = Blob->GetNodeBox(Id);
+			auto const Lo = FInteriorChunkCoord::FromPosition(Box.Min, ChunkSize);
+			auto const Hi = FInteriorChunkCoord::FromPosition(Box.Max, ChunkSize);
+			Reach = FMath::Max(Reach, FMath::Max3(Coord.X - Lo.X, Coord.Y - Lo.Y, Coord.Z - Lo.Z));
+			Reach = FMath::Max(Reach, FMath::Max3(Hi.X - Coord.X, Hi.Y - Coord.Y, Hi.Z - Coord.Z));
+		}
+	}
+}
+
+void AInteriorGraphChunkActor::Serialize(FArchive& Ar)
+{
+	Super::Serialize(Ar);
+
+	// Nothing depends on the version yet, but it is recorded so that later layout changes can be read back
+	Ar.UsingCustomVersion(FInteriorGraphCustomVersion::GUID);
+
+	Ar << Coord;
+	Ar << ChunkData;
+	Ar << BorderPortals;
+
+	if(Ar.IsLoading())
+	{
+		BindBlob();
+	}
+}
+
+void AInteriorGraphChunkActor::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if(Blob.IsValid() && ChunkSize > 0.f)
+	{
+		FInteriorStreamedGraph::FindOrCreate(GetWorld(), GraphId, ChunkSize)->AddChunk(this);
+	}
+}
+
+void AInteriorGraphChunkActor::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	auto Graph = FInteriorStreamedGraph::Get(GetWorld(), GraphId);
+	if(Graph.IsValid())
+	{
+		Graph->RemoveChunk(this);
+		FInteriorStreamedGraph::Release(GetWorld(), GraphId);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+
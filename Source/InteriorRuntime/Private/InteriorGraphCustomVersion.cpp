@@ -0,0 +1,15 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "InteriorRuntimePrivatePCH.h"
+#include "InteriorGraphCustomVersion.h"
+
+
+const FGuid FInteriorGraphCustomVersion::GUID(0x6C1E3A27, 0x94B04F5D, 0xA2D8716E, 0x3F09C4B1);
+
+FCustomVersionRegistration GRegisterInteriorGraphCustomVersion(
+	FInteriorGraphCustomVersion::GUID,
+	FInteriorGraphCustomVersion::LatestVersion,
+	TEXT("InteriorGraphVer")
+	);
+
+
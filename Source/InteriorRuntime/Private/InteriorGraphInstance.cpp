@@ -1,6 +1,6 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
-#include "InteriorEditorPrivatePCH.h"
+#include "InteriorRuntimePrivatePCH.h"
 #include "InteriorGraphTypes.h"
 #include "InteriorGraphInstance.h"
 
@@ -10,6 +10,13 @@ FInteriorGraphInstance::FInteriorGraphInstance()
 
 }
 
+void FInteriorGraphInstance::Serialize(FArchive& Ar)
+{
+	Ar << NodeData;
+	Ar << ConnData;
+	Ar << CellOrigins;
+}
+
 int32 FInteriorGraphInstance::NodeCount() const
 {
 	return NodeData.Num();
@@ -97,6 +104,46 @@ ConnectionIdList FInteriorGraphInstance::GetAllNodeConnections(NodeIdType id) co
 	return List;
 }
 
+#if INTERIOR_GRAPH_DEBUG_NAMES
+FString FInteriorGraphInstance::GetNodeName(NodeIdType Id) const
+{
+	auto Eager = NodeNames.Find(Id);
+	if(Eager)
+	{
+		return *Eager;
+	}
+
+	if(!CellOrigins.IsValidIndex(Id))
+	{
+		return FString{};
+	}
+
+	auto const& Origin = CellOrigins[Id];
+	auto OrigName = OriginalNodeNames.Find(Origin.OriginalNode);
+
+	FString Nm = OrigName ? *OrigName : FString::Printf(TEXT("Node %d"), Origin.OriginalNode);
+	if(Origin.IsGridCell())
+	{
+		Nm += FString::Printf(TEXT("[%d][%d][%d]"), Origin.X, Origin.Y, Origin.Z);
+	}
+	else
+	{
+		Nm += FString::Printf(TEXT("[%d]"), Origin.X);
+	}
+	Nm += FString::Printf(TEXT(":%d-(%d)"), Id, NodeData[Id].Outgoing.Num());
+	return Nm;
+}
+
+void FInteriorGraphInstance::GenerateNodeNames()
+{
+	NodeNames.Empty(NodeCount());
+	for(NodeIdType Id = 0; Id < NodeCount(); ++Id)
+	{
+		NodeNames.Add(Id, GetNodeName(Id));
+	}
+}
+#endif
+
 ConnectionIdList FInteriorGraphInstance::GetConnectionsOnFace(NodeIdType NId, struct FFaceId const& Face) const
 {
 	auto Conns = GetAllNodeConnections(NId);
@@ -0,0 +1,230 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "InteriorRuntimePrivatePCH.h"
+#include "InteriorGraphStreaming.h"
+#include "InteriorGraphBlob.h"
+
+
+static TMap< TWeakObjectPtr< UWorld >, TMap< FGuid, TSharedPtr< FInteriorStreamedGraph > > > StreamedGraphs;
+
+
+TSharedPtr< FInteriorStreamedGraph > FInteriorStreamedGraph::Get(UWorld* World, FGuid const& GraphId)
+{
+	auto WorldGraphs = StreamedGraphs.Find(World);
+	if(!WorldGraphs)
+	{
+		return nullptr;
+	}
+
+	return WorldGraphs->FindRef(GraphId);
+}
+
+TSharedPtr< FInteriorStreamedGraph > FInteriorStreamedGraph::FindOrCreate(UWorld* World, FGuid const& GraphId, float ChunkSize)
+{
+	auto& Graph = StreamedGraphs.FindOrAdd(World).FindOrAdd(GraphId);
+	if(!Graph.IsValid())
+	{
+		Graph = MakeShareable(new FInteriorStreamedGraph(ChunkSize));
+	}
+	return Graph;
+}
+
+void FInteriorStreamedGraph::Release(UWorld* World, FGuid const& GraphId)
+{
+	auto WorldGraphs = StreamedGraphs.Find(World);
+	if(!WorldGraphs)
+	{
+		return;
+	}
+
+	auto Graph = WorldGraphs->FindRef(GraphId);
+	if(Graph.IsValid() && Graph->GetResidentChunkCount() == 0)
+	{
+		WorldGraphs->Remove(GraphId);
+	}
+
+	if(WorldGraphs->Num() == 0)
+	{
+		StreamedGraphs.Remove(World);
+	}
+}
+
+
+FInteriorStreamedGraph::FInteriorStreamedGraph(float InChunkSize):
+ChunkSize(InChunkSize)
+, MaxReach(0)
+{
+
+}
+
+void FInteriorStreamedGraph::AddChunk(AInteriorGraphChunkActor* Chunk)
+{
+	check(Chunk && Chunk->GetBlob());
+
+	// Replace whatever was previously registered at the same coordinate, even if it has since gone away
+	if(Chunks.Contains(Chunk->Coord))
+	{
+		RemoveCoord(Chunk->Coord);
+	}
+
+	Chunks.Add(Chunk->Coord, Chunk);
+	MaxReach = FMath::Max(MaxReach, Chunk->GetReach());
+
+	// Stitch portals out of the new chunk, and portals from already resident chunks into it
+	Stitch(Chunk, nullptr);
+	for(auto const& Entry : Chunks)
+	{
+		auto Other = Entry.Value.Get();
+		if(Other && Other != Chunk)
+		{
+			Stitch(Other, &Chunk->Coord);
+		}
+	}
+}
+
+void FInteriorStreamedGraph::RemoveChunk(AInteriorGraphChunkActor* Chunk)
+{
+	if(!Chunk)
+	{
+		return;
+	}
+
+	auto Existing = Chunks.Find(Chunk->Coord);
+	if(!Existing || Existing->Get() != Chunk)
+	{
+		return;
+	}
+
+	RemoveCoord(Chunk->Coord);
+}
+
+void FInteriorStreamedGraph::RemoveCoord(FInteriorChunkCoord const& Coord)
+{
+	Chunks.Remove(Coord);
+
+	MaxReach = 0;
+	for(auto const& Entry : Chunks)
+	{
+		if(Entry.Value.IsValid())
+		{
+			MaxReach = FMath::Max(MaxReach, Entry.Value->GetReach());
+		}
+	}
+
+	for(auto It = Stitched.CreateIterator(); It; ++It)
+	{
+		if(It.Key().Chunk == Coord || It.Value().Chunk == Coord)
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+void FInteriorStreamedGraph::Stitch(AInteriorGraphChunkActor* From, FInteriorChunkCoord const* OnlyTo)
+{
+	auto FromBlob = From->GetBlob();
+	for(auto const& BP : From->BorderPortals)
+	{
+		if(OnlyTo && BP.NeighbourChunk != *OnlyTo)
+		{
+			continue;
+		}
+
+		auto ToBlob = GetChunkBlob(BP.NeighbourChunk);
+		if(!ToBlob ||
+			BP.LocalNode < 0 || BP.LocalNode >= FromBlob->NodeCount() ||
+			BP.NeighbourNode < 0 || BP.NeighbourNode >= ToBlob->NodeCount())
+		{
+			continue;
+		}
+
+		auto const Src = FStreamedNodeRef{ From->Coord, BP.LocalNode };
+		auto const Dest = FStreamedNodeRef{ BP.NeighbourChunk, BP.NeighbourNode };
+		Stitched.AddUnique(Src, Dest);
+	}
+}
+
+bool FInteriorStreamedGraph::IsChunkResident(FInteriorChunkCoord const& Coord) const
+{
+	return GetChunkBlob(Coord) != nullptr;
+}
+
+int32 FInteriorStreamedGraph::GetResidentChunkCount() const
+{
+	return Chunks.Num();
+}
+
+FInteriorGraphBlob const* FInteriorStreamedGraph::GetChunkBlob(FInteriorChunkCoord const& Coord) const
+{
+	auto Chunk = Chunks.Find(Coord);
+	return Chunk && Chunk->IsValid() ? (*Chunk)->GetBlob() : nullptr;
+}
+
+FStreamedNodeRef FInteriorStreamedGraph::GetNodeFromPosition(FVector const& Pos) const
+{
+	// Cells belong to the chunk containing their centre, so may extend as far as the reach of their chunk
+	auto const Centre = FInteriorChunkCoord::FromPosition(Pos, ChunkSize);
+	for(int32 Dist = 0; Dist <= MaxReach; ++Dist)
+	{
+		for(int32 DZ = -Dist; DZ <= Dist; ++DZ)
+		{
+			for(int32 DY = -Dist; DY <= Dist; ++DY)
+			{
+				for(int32 DX = -Dist; DX <= Dist; ++DX)
+				{
+					// Only the shell at this distance
+					if(FMath::Max3(FMath::Abs(DX), FMath::Abs(DY), FMath::Abs(DZ)) != Dist)
+					{
+						continue;
+					}
+
+					auto const Coord = FInteriorChunkCoord{ Centre.X + DX, Centre.Y + DY, Centre.Z + DZ };
+					auto Chunk = Chunks.Find(Coord);
+					auto Blob = Chunk && Chunk->IsValid() ? (*Chunk)->GetBlob() : nullptr;
+					if(!Blob || (*Chunk)->GetReach() < Dist)
+					{
+						continue;
+					}
+
+					auto const Id = Blob->GetNodeFromPosition(Pos);
+					if(Id != NullNode)
+					{
+						return FStreamedNodeRef{ Coord, Id };
+					}
+				}
+			}
+		}
+	}
+
+	return FStreamedNodeRef{ Centre, NullNode };
+}
+
+FBox FInteriorStreamedGraph::GetNodeBox(FStreamedNodeRef const& Ref) const
+{
+	auto Blob = GetChunkBlob(Ref.Chunk);
+	check(Blob);
+	return Blob->GetNodeBox(Ref.Node);
+}
+
+TArray< FStreamedNodeRef > FInteriorStreamedGraph::GetAdjacentNodes(FStreamedNodeRef const& Ref) const
+{
+	TArray< FStreamedNodeRef > Adj;
+
+	auto Blob = GetChunkBlob(Ref.Chunk);
+	if(!Blob || Ref.Node < 0 || Ref.Node >= Blob->NodeCount())
+	{
+		return Adj;
+	}
+
+	for(auto Id : Blob->GetAdjacentNodes(Ref.Node))
+	{
+		Adj.Add(FStreamedNodeRef{ Ref.Chunk, Id });
+	}
+
+	TArray< FStreamedNodeRef > Remote;
+	Stitched.MultiFind(Ref, Remote);
+	Adj.Append(Remote);
+	return Adj;
+}
+
+
@@ -0,0 +1,12 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "InteriorRuntimePrivatePCH.h"
+
+
+/*
+The runtime module holds built graph data and the means to query it, so that packaged games can load graphs built
+in the editor. Everything needed to author or build graphs stays in the editor module.
+*/
+IMPLEMENT_MODULE(FDefaultModuleImpl, InteriorRuntime)
+
+
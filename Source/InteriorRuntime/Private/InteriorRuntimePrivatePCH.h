@@ -0,0 +1,7 @@
+
+#pragma once
+
+#include "Core.h"
+#include "CoreUObject.h"
+#include "Engine.h"
+
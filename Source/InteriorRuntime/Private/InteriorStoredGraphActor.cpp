@@ -0,0 +1,138 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "InteriorRuntimePrivatePCH.h"
+#include "InteriorStoredGraphActor.h"
+#include "InteriorGraphInstance.h"
+#include "InteriorGraphBlob.h"
+#include "InteriorGraphCustomVersion.h"
+#include "EngineUtils.h"
+
+
+AInteriorStoredGraphActor::AInteriorStoredGraphActor(FObjectInitializer const& OI):
+Super(OI)
+{
+
+}
+
+AInteriorStoredGraphActor* AInteriorStoredGraphActor::Find(UWorld* World, FGuid const& GraphId)
+{
+	if(!World || !GraphId.IsValid())
+	{
+		return nullptr;
+	}
+
+	for(TActorIterator< AInteriorStoredGraphActor > It(World); It; ++It)
+	{
+		if(It->GraphId == GraphId)
+		{
+			return *It;
+		}
+	}
+	return nullptr;
+}
+
+void AInteriorStoredGraphActor::SetGraph(TSharedPtr< FInteriorGraphInstance > Inst)
+{
+	if(!Inst.IsValid())
+	{
+		ClearGraph();
+		return;
+	}
+
+	FInteriorGraphBlob::Write(*Inst, GraphData);
+	BindBlob();
+#if INTERIOR_GRAPH_DEBUG_NAMES
+	OriginalNodeNames = Inst->OriginalNodeNames;
+#endif
+
+	// Hand out the instance we already have, rather than expanding the blob again
+	if(Blob.IsValid())
+	{
+		Instance = Inst;
+	}
+}
+
+void AInteriorStoredGraphActor::ClearGraph()
+{
+	GraphData.Empty();
+	Blob.Reset();
+	Instance.Reset();
+#if INTERIOR_GRAPH_DEBUG_NAMES
+	OriginalNodeNames.Empty();
+#endif
+}
+
+bool AInteriorStoredGraphActor::HasGraph() const
+{
+	return Blob.IsValid();
+}
+
+FInteriorGraphBlob const* AInteriorStoredGraphActor::GetBlob() const
+{
+	return Blob.Get();
+}
+
+TSharedPtr< FInteriorGraphInstance > AInteriorStoredGraphActor::GetInstance()
+{
+	if(!Instance.IsValid() && Blob.IsValid())
+	{
+		Instance = MakeShareable(new FInteriorGraphInstance);
+		Blob->ToInstance(*Instance);
+#if INTERIOR_GRAPH_DEBUG_NAMES
+		Instance->OriginalNodeNames = OriginalNodeNames;
+#endif
+	}
+
+	return Instance;
+}
+
+void AInteriorStoredGraphActor::BindBlob()
+{
+	Blob.Reset();
+	Instance.Reset();
+
+	if(GraphData.Num() == 0)
+	{
+		return;
+	}
+
+	auto NewBlob = MakeShareable(new FInteriorGraphBlob);
+	if(!NewBlob->Initialize(GraphData.GetData(), GraphData.Num()))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s: discarding invalid stored interior graph"), *GetName());
+		GraphData.Empty();
+		return;
+	}
+
+	Blob = NewBlob;
+}
+
+void AInteriorStoredGraphActor::Serialize(FArchive& Ar)
+{
+	Super::Serialize(Ar);
+
+	Ar.UsingCustomVersion(FInteriorGraphCustomVersion::GUID);
+
+	Ar << GraphData;
+
+	// Names are debug only, so are stripped when cooking
+	bool bHasNames = INTERIOR_GRAPH_DEBUG_NAMES && !Ar.IsCooking();
+	Ar << bHasNames;
+	if(bHasNames)
+	{
+#if INTERIOR_GRAPH_DEBUG_NAMES
+		Ar << OriginalNodeNames;
+#else
+		// Read only to skip past them
+		TMap< NodeIdType, FString > SkippedNames;
+		Ar << SkippedNames;
+#endif
+	}
+
+	if(Ar.IsLoading())
+	{
+		BindBlob();
+	}
+}
+
+
@@ -28,7 +28,7 @@ enum class EAxisDirection {
 	None = 0,
 };
 
-struct FAxisUtils
+struct INTERIORRUNTIME_API FAxisUtils
 {
 	static const EAxisIndex AllAxes[EAxisIndex::Count];
 	static const EAxisIndex OtherAxes[EAxisIndex::Count][2];
@@ -69,8 +69,8 @@ inline float GetDirectionMultiplier(EAxisDirection Dir)
 	return Dir == EAxisDirection::Positive ? 1.0f : (Dir == EAxisDirection::Negative ? -1.0f : 0.0f);
 }
 
-float CalculateRelativeAxisSeparation(EAxisIndex axis, FBox const& Box1, FBox const& Box2);
-EAABBRelativeAxisState CalculateRelativeAxisState(EAxisIndex axis, FBox const& Box1, FBox const& Box2, float Epsilon = 1.e-4f);
-bool TestForSharedSurface(FBox const& Box1, FBox const& Box2, float Epsilon = 1.e-4f, FAxisAlignedPlanarArea* OutArea = nullptr);
+INTERIORRUNTIME_API float CalculateRelativeAxisSeparation(EAxisIndex axis, FBox const& Box1, FBox const& Box2);
+INTERIORRUNTIME_API EAABBRelativeAxisState CalculateRelativeAxisState(EAxisIndex axis, FBox const& Box1, FBox const& Box2, float Epsilon = 1.e-4f);
+INTERIORRUNTIME_API bool TestForSharedSurface(FBox const& Box1, FBox const& Box2, float Epsilon = 1.e-4f, FAxisAlignedPlanarArea* OutArea = nullptr);
 
 
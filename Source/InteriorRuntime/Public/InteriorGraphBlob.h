@@ -0,0 +1,134 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "InteriorGraphTypes.h"
+#include "InteriorGraphInstance.h"
+
+
+/*
+Flat, immutable, relocatable binary layout for a built graph instance.
+
+All sections are referenced by byte offsets from the start of the blob, so a blob can be used in place from any
+4-byte aligned buffer (bulk loaded or memory mapped) after a single validation pass, with no per-element
+deserialization or allocation.
+
+Streamed graph chunks (FInteriorStreamedGraph) and AInteriorStoredGraphActor::GetBlob are queried in place.
+Consumers wanting a mutable FInteriorGraphInstance (the derived data cache, and GetInstance) use the blob only as
+a storage format and expand it with ToInstance, which does cost a full copy.
+
+Layout (all values little endian):
+	FInteriorGraphBlobHeader
+	FInteriorGraphBlobBox			[NodeCount]			Node bounds
+	uint32							[NodeCount + 1]		CSR row offsets into the outgoing array
+	int32							[OutgoingCount]		Outgoing connection ids, grouped by source node
+	FInteriorGraphBlobConnection	[ConnectionCount]	Connection endpoints and portals
+	FInteriorCellOrigin				[NodeCount]			Cell origins
+*/
+
+struct FInteriorGraphBlobBox
+{
+	float Min[3];
+	float Max[3];
+
+	inline FBox ToBox() const
+	{
+		return FBox{ FVector{ Min[0], Min[1], Min[2] }, FVector{ Max[0], Max[1], Max[2] } };
+	}
+
+	static inline FInteriorGraphBlobBox FromBox(FBox const& Box)
+	{
+		return FInteriorGraphBlobBox{
+			{ Box.Min.X, Box.Min.Y, Box.Min.Z },
+			{ Box.Max.X, Box.Max.Y, Box.Max.Z }
+		};
+	}
+};
+
+struct FInteriorGraphBlobConnection
+{
+	int32 Src;
+	int32 Dest;
+	FInteriorGraphBlobBox Portal;
+};
+
+struct FInteriorGraphBlobHeader
+{
+	uint32 Magic;
+	uint32 Version;
+	uint32 TotalSize;
+
+	uint32 NodeCount;
+	uint32 ConnectionCount;
+
+	uint32 NodeBoundsOffset;
+	uint32 OutgoingRowsOffset;
+	uint32 OutgoingOffset;
+	uint32 ConnectionsOffset;
+	uint32 CellOriginsOffset;
+};
+
+
+/*
+Read-only view over a blob. Does not own the memory, which must outlive the view.
+*/
+class INTERIORRUNTIME_API FInteriorGraphBlob
+{
+public:
+	static const uint32 Magic;
+	static const uint32 Version;
+
+public:
+	FInteriorGraphBlob();
+
+	/*
+	Lays out the given instance as a blob, replacing the contents of OutData.
+	*/
+	static void Write(FInteriorGraphInstance const& Inst, TArray< uint8 >& OutData);
+
+	/*
+	Validates the buffer and, if it holds a well formed blob, binds the view to it.
+	*/
+	bool Initialize(const uint8* Data, int64 Size);
+	bool IsValid() const;
+
+	/*
+	Expands the blob into a mutable instance. Prefer the query interface below where a copy isn't needed.
+	*/
+	void ToInstance(FInteriorGraphInstance& Inst) const;
+
+public:
+	/*
+	Query interface mirroring FInteriorGraphInstance
+	*/
+	int32 NodeCount() const;
+	int32 ConnectionCount() const;
+
+	FBox GetNodeBox(NodeIdType Id) const;
+	FConnectionData GetConnectionData(ConnectionIdType Id) const;
+	FInteriorCellOrigin const& GetCellOrigin(NodeIdType Id) const;
+
+	/*
+	Returns a pointer to the outgoing connection ids of the node, setting OutNum to their count.
+	*/
+	const ConnectionIdType* GetNodeOutConnections(NodeIdType Id, int32& OutNum) const;
+	NodeIdList GetAdjacentNodes(NodeIdType Id) const;
+	NodeIdType GetNodeFromPosition(FVector const& Pos) const;
+
+protected:
+	template < typename T >
+	inline const T* Section(uint32 Offset) const
+	{
+		return reinterpret_cast< const T* >(Base + Offset);
+	}
+
+protected:
+	const uint8* Base;
+	const FInteriorGraphBlobHeader* Header;
+	const FInteriorGraphBlobBox* NodeBounds;
+	const uint32* OutgoingRows;
+	const int32* Outgoing;
+	const FInteriorGraphBlobConnection* Connections;
+	const FInteriorCellOrigin* CellOrigins;
+};
+
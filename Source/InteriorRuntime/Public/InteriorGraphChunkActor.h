@@ -0,0 +1,129 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "GameFramework/Actor.h"
+#include "InteriorGraphTypes.h"
+#include "InteriorGraphChunkActor.generated.h"
+
+
+/*
+Integer coordinate of a spatial chunk of an interior graph.
+*/
+struct FInteriorChunkCoord
+{
+	int32 X, Y, Z;
+
+	inline bool operator== (FInteriorChunkCoord const& Rhs) const
+	{
+		return X == Rhs.X && Y == Rhs.Y && Z == Rhs.Z;
+	}
+
+	inline bool operator!= (FInteriorChunkCoord const& Rhs) const
+	{
+		return !(*this == Rhs);
+	}
+
+	static inline FInteriorChunkCoord FromPosition(FVector const& Pos, float ChunkSize)
+	{
+		return FInteriorChunkCoord{
+			FMath::FloorToInt(Pos.X / ChunkSize),
+			FMath::FloorToInt(Pos.Y / ChunkSize),
+			FMath::FloorToInt(Pos.Z / ChunkSize)
+		};
+	}
+
+	friend inline uint32 GetTypeHash(FInteriorChunkCoord const& Coord)
+	{
+		return HashCombine(HashCombine(GetTypeHash(Coord.X), GetTypeHash(Coord.Y)), GetTypeHash(Coord.Z));
+	}
+};
+
+inline FArchive& operator<< (FArchive& Ar, FInteriorChunkCoord& Coord)
+{
+	Ar << Coord.X << Coord.Y << Coord.Z;
+	return Ar;
+}
+
+/*
+A built connection from a cell of one chunk to a cell of a neighbouring chunk. Such connections are only usable
+while both chunks are resident.
+*/
+struct FInteriorGraphBorderPortal
+{
+	// Local id of the source cell within this chunk
+	NodeIdType LocalNode;
+	FInteriorChunkCoord NeighbourChunk;
+	// Local id of the destination cell within the neighbouring chunk
+	NodeIdType NeighbourNode;
+	FBox Portal;
+};
+
+inline FArchive& operator<< (FArchive& Ar, FInteriorGraphBorderPortal& BP)
+{
+	Ar << BP.LocalNode << BP.NeighbourChunk << BP.NeighbourNode << BP.Portal;
+	return Ar;
+}
+
+
+/*
+Holds one spatial chunk of a built interior graph, so that large graphs can be split across streaming levels.
+Chunks register with the streamed graph for their world on BeginPlay, and unregister on EndPlay, at which point
+portals along shared borders are stitched or unstitched.
+*/
+UCLASS(NotPlaceable)
+class INTERIORRUNTIME_API AInteriorGraphChunkActor: public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AInteriorGraphChunkActor(FObjectInitializer const& OI);
+
+public:
+	// Identifies the graph this chunk was split from
+	UPROPERTY(VisibleAnywhere, Category = "Chunk")
+	FGuid GraphId;
+
+	UPROPERTY(VisibleAnywhere, Category = "Chunk")
+	float ChunkSize;
+
+	FInteriorChunkCoord Coord;
+
+	// The chunk's cells, in FInteriorGraphBlob layout, with chunk-local ids
+	TArray< uint8 > ChunkData;
+	TArray< FInteriorGraphBorderPortal > BorderPortals;
+
+public:
+	/*
+	Replaces the chunk's contents with the given cells (chunk-local ids) and border portals.
+	*/
+	void SetChunkData(
+		FInteriorChunkCoord const& InCoord,
+		class FInteriorGraphInstance const& Inst,
+		TArray< FInteriorGraphBorderPortal > const& InBorderPortals
+		);
+	/*
+	Returns a view over ChunkData, or null if it is not a valid blob.
+	*/
+	class FInteriorGraphBlob const* GetBlob() const;
+	/*
+	How many chunks beyond its own the cells of this chunk extend, since a cell belongs only to the chunk
+	containing its centre.
+	*/
+	int32 GetReach() const;
+
+public:
+	// Overrides
+	virtual void Serialize(FArchive& Ar) override;
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+protected:
+	void BindBlob();
+
+protected:
+	TSharedPtr< class FInteriorGraphBlob > Blob;
+	int32 Reach;
+};
+
+
@@ -0,0 +1,41 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CustomVersion.h"
+
+
+/*
+Custom serialization version for AInteriorGraphActor data.
+*/
+struct INTERIORRUNTIME_API FInteriorGraphCustomVersion
+{
+	enum Type
+	{
+		// Per-element node/connection records, always followed by names
+		BeforeCustomVersionWasAdded = 0,
+		// Packed POD records, bulk serialized
+		BulkRecords,
+		// Node/connection names are preceded by a flag, and are omitted from cooked data
+		OptionalNames,
+		// A packed, prebuilt graph instance blob follows the names
+		StoredGraph,
+		// Records are preceded by an encoding flag, and may be quantized
+		QuantizedRecords,
+		// The stored graph is held by an AInteriorStoredGraphActor rather than following the names
+		StoredGraphActor,
+		// The settings of the stored build follow the names
+		StoredBuildSettings,
+
+		// -----<new versions can be added above this line>-------------------------------------------------
+		VersionPlusOne,
+		LatestVersion = VersionPlusOne - 1
+	};
+
+	static const FGuid GUID;
+
+private:
+	FInteriorGraphCustomVersion() {}
+};
+
+
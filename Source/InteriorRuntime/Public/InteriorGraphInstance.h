@@ -0,0 +1,95 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "InteriorGraphTypes.h"
+
+
+/*
+Records which original node a built cell was generated from, and where within it.
+For cells on a uniform subdivision grid, X/Y/Z are grid coordinates. Otherwise (adaptive or merged cells) X is
+the index of the cell within its original node, and Y and Z are INDEX_NONE.
+*/
+struct FInteriorCellOrigin
+{
+	NodeIdType OriginalNode;
+	int32 X, Y, Z;
+
+	inline bool IsGridCell() const
+	{
+		return Y != INDEX_NONE;
+	}
+};
+
+inline FArchive& operator<< (FArchive& Ar, FInteriorCellOrigin& Origin)
+{
+	Ar << Origin.OriginalNode << Origin.X << Origin.Y << Origin.Z;
+	return Ar;
+}
+
+/*
+Actor representing a built instance of an interior graph.
+*/
+class INTERIORRUNTIME_API FInteriorGraphInstance
+{
+public:
+	TArray< FNodeData > NodeData;
+	TArray< FConnectionData > ConnData;
+
+	// Per node, the original node and location it was generated from
+	TArray< FInteriorCellOrigin > CellOrigins;
+
+public:
+	FInteriorGraphInstance();
+
+	/*
+	Serializes the built node, connection and origin data. Names are not included.
+	*/
+	void Serialize(FArchive& Ar);
+
+public:
+	typedef TArray< NodeIdType > NodeIdList;
+	typedef TArray< ConnectionIdType > ConnectionIdList;
+
+	/*
+	Interface to the graph for when in-game
+	*/
+	int32 NodeCount() const;
+	int32 ConnectionCount() const;
+
+	FNodeData const& GetNodeData(NodeIdType id) const;
+	FConnectionData const& GetConnectionData(ConnectionIdType id) const;
+
+	FNodeData& GetNodeDataRef(NodeIdType id);
+	FConnectionData& GetConnectionDataRef(ConnectionIdType id);
+
+	NodeIdList GetAdjacentNodes(NodeIdType src) const;
+	NodeIdType GetNodeFromPosition(FVector const& pos) const;
+	ConnectionIdList GetNodeOutConnections(NodeIdType id) const;
+	ConnectionIdList GetNodeInConnections(NodeIdType id) const;
+	ConnectionIdList GetAllNodeConnections(NodeIdType id) const;
+	ConnectionIdList GetConnectionsOnFace(NodeIdType NId, struct FFaceId const& Face) const;
+
+#if INTERIOR_GRAPH_DEBUG_NAMES
+public:
+	/*
+	Debug name of a node, generated on demand from its origin unless names were generated eagerly at build time.
+	*/
+	FString GetNodeName(NodeIdType Id) const;
+	/*
+	Fills NodeNames for every node, from the original node names.
+	*/
+	void GenerateNodeNames();
+
+	/*
+	Eagerly generated names, only populated when building with FInteriorGraphBuildSettings::bEagerDebugNames.
+	*/
+	TMap< NodeIdType, FString > NodeNames;
+	TMap< ConnectionIdType, FString > ConnNames;
+
+	// Names of the original nodes, from which node names are generated
+	TMap< NodeIdType, FString > OriginalNodeNames;
+#endif
+};
+
+
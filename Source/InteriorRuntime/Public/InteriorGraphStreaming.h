@@ -0,0 +1,83 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "InteriorGraphTypes.h"
+#include "InteriorGraphChunkActor.h"
+
+
+/*
+Identifies a cell of a streamed graph.
+*/
+struct FStreamedNodeRef
+{
+	FInteriorChunkCoord Chunk;
+	NodeIdType Node;
+
+	inline bool IsValid() const
+	{
+		return Node != NullNode;
+	}
+
+	inline bool operator== (FStreamedNodeRef const& Rhs) const
+	{
+		return Chunk == Rhs.Chunk && Node == Rhs.Node;
+	}
+
+	friend inline uint32 GetTypeHash(FStreamedNodeRef const& Ref)
+	{
+		return HashCombine(GetTypeHash(Ref.Chunk), GetTypeHash(Ref.Node));
+	}
+};
+
+/*
+Runtime view of the resident chunks of one streamed interior graph within a world.
+*/
+class INTERIORRUNTIME_API FInteriorStreamedGraph
+{
+public:
+	/*
+	Returns the streamed graph with the given id in the world, or null if none of its chunks are resident.
+	*/
+	static TSharedPtr< FInteriorStreamedGraph > Get(UWorld* World, FGuid const& GraphId);
+	static TSharedPtr< FInteriorStreamedGraph > FindOrCreate(UWorld* World, FGuid const& GraphId, float ChunkSize);
+	/*
+	Forgets the streamed graph with the given id in the world, if it has no resident chunks.
+	*/
+	static void Release(UWorld* World, FGuid const& GraphId);
+
+public:
+	FInteriorStreamedGraph(float InChunkSize);
+
+	void AddChunk(AInteriorGraphChunkActor* Chunk);
+	void RemoveChunk(AInteriorGraphChunkActor* Chunk);
+	bool IsChunkResident(FInteriorChunkCoord const& Coord) const;
+	int32 GetResidentChunkCount() const;
+
+public:
+	/*
+	Query interface, over resident chunks only
+	*/
+	FStreamedNodeRef GetNodeFromPosition(FVector const& Pos) const;
+	FBox GetNodeBox(FStreamedNodeRef const& Ref) const;
+	TArray< FStreamedNodeRef > GetAdjacentNodes(FStreamedNodeRef const& Ref) const;
+
+protected:
+	class FInteriorGraphBlob const* GetChunkBlob(FInteriorChunkCoord const& Coord) const;
+	void RemoveCoord(FInteriorChunkCoord const& Coord);
+	/*
+	Stitches the border portals of From whose neighbouring chunk is resident, optionally only those into OnlyTo.
+	*/
+	void Stitch(AInteriorGraphChunkActor* From, FInteriorChunkCoord const* OnlyTo);
+
+protected:
+	float ChunkSize;
+	TMap< FInteriorChunkCoord, TWeakObjectPtr< AInteriorGraphChunkActor > > Chunks;
+	// Greatest reach of any resident chunk, bounding the search for the cell containing a position
+	int32 MaxReach;
+
+	// Border portals for which both sides are resident, keyed by source cell
+	TMultiMap< FStreamedNodeRef, FStreamedNodeRef > Stitched;
+};
+
+
@@ -5,6 +5,15 @@
 #include "InteriorEditorNodeFace.h"
 
 
+/*
+Whether node and connection names are kept. They are stripped from cooked graph data, so would be of no use in shipping
+builds. The editor module is never part of a shipping build, so this only has an effect on the runtime module.
+*/
+#ifndef INTERIOR_GRAPH_DEBUG_NAMES
+#define INTERIOR_GRAPH_DEBUG_NAMES (!UE_BUILD_SHIPPING)
+#endif
+
+
 struct FNodeData
 {
 	FVector Min;
@@ -123,5 +132,18 @@ struct FConnectionData
 };
 
 
+inline FArchive& operator<< (FArchive& Ar, FNodeData& ND)
+{
+	Ar << ND.Min << ND.Max << ND.Outgoing;
+	return Ar;
+}
+
+inline FArchive& operator<< (FArchive& Ar, FConnectionData& CD)
+{
+	Ar << CD.Src << CD.Dest << CD.Portal;
+	return Ar;
+}
+
+
 
 
@@ -0,0 +1,70 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "GameFramework/Actor.h"
+#include "InteriorGraphTypes.h"
+#include "InteriorStoredGraphActor.generated.h"
+
+
+/*
+Holds the prebuilt graph of an interior graph actor, so that it is loaded with the level and can be queried at
+runtime without rebuilding, or the editor module. Created and updated by AInteriorGraphActor::StoreGraph.
+Cell origins refer to the ids the original nodes had when the graph was stored, and so only relate to the original
+node names held here, not to the graph actor's current ids.
+*/
+UCLASS(NotPlaceable)
+class INTERIORRUNTIME_API AInteriorStoredGraphActor: public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AInteriorStoredGraphActor(FObjectInitializer const& OI);
+
+public:
+	// Identifies the graph this was built from
+	UPROPERTY(VisibleAnywhere, Category = "Graph")
+	FGuid GraphId;
+
+public:
+	/*
+	Returns the stored graph with the given id in the world, or null if none is loaded.
+	*/
+	static AInteriorStoredGraphActor* Find(UWorld* World, FGuid const& GraphId);
+
+public:
+	/*
+	Replaces the stored graph with the given instance, which is kept to be handed out by GetInstance.
+	*/
+	void SetGraph(TSharedPtr< class FInteriorGraphInstance > Inst);
+	void ClearGraph();
+	bool HasGraph() const;
+	/*
+	The blob is a view directly over the loaded data, the instance is expanded from it on first request. Both are
+	null if nothing is stored.
+	*/
+	class FInteriorGraphBlob const* GetBlob() const;
+	TSharedPtr< class FInteriorGraphInstance > GetInstance();
+
+public:
+	// Overrides
+	virtual void Serialize(FArchive& Ar) override;
+
+protected:
+	/*
+	Validates GraphData and binds the blob view to it, discarding the data if it is not a valid blob.
+	*/
+	void BindBlob();
+
+protected:
+	// The stored graph in FInteriorGraphBlob layout
+	TArray< uint8 > GraphData;
+	TSharedPtr< class FInteriorGraphBlob > Blob;
+	TSharedPtr< class FInteriorGraphInstance > Instance;
+
+#if INTERIOR_GRAPH_DEBUG_NAMES
+	TMap< NodeIdType, FString > OriginalNodeNames;
+#endif
+};
+
+